@@ -14,12 +14,37 @@
 #include <linux/kdev_t.h>
 #include <linux/wait.h>
 #include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/irq.h>
+#include <linux/math64.h>
+#include <linux/of.h>
+#include <linux/sizes.h>
+#include <linux/highmem.h>
+#include <linux/scatterlist.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/log2.h>
 #include <ctrl/am335x_ctrl.h>
 #include <ctrl/am335x_regs.h>
+#include <pl_par_trace.h>
 
 #define TIMING_DEVICE_NAME      "timings"
 #define POLARITY_DEVICE_NAME    "polarities"
 #define TIMEOUT_MSECS           10000
+#define DMA_TIMEOUT_MSECS       3000
+#define DMA_MIN_WORDS           64
+#define DMA_CHUNK_WORDS         (AM335X_DMA_CHUNK_SIZE / sizeof(short))
+#define HRDY_SPIN_DEFAULT_NS    20000
+#define HRDY_SPIN_MIN_NS        500
+#define HRDY_SPIN_MAX_US        1000
+#define HRDY_WAIT_AVG_SHIFT     3
+#define CAL_MAX_WORDS           1024
+#define CAL_PATTERNS            4
+#define CAL_HRDY_TIMEOUT_MSECS  100
+#define CLK_FREQ_MIN            25000000ul
+#define CLK_FREQ_MAX            300000000ul
+#define CLK_FREQ_STEP           1000000ul
+#define CLK_DIV_MAX             255
 
 #define timing_dev_to_ctrl(tdev) container_of(tdev, struct am335x_ctrl, timing_dev)
 #define pol_dev_to_ctrl(pdev) container_of(pdev, struct am335x_ctrl, pol_dev)
@@ -27,6 +52,360 @@
 
 #undef WRITE_DATA_BURST
 
+////////////////////////////////////////////////////////////////////////////////
+// Statistics
+
+/*
+ * The counters are updated without locking. The transfers are serialized by
+ * the bus lock, the readers may see slightly inconsistent values.
+ */
+static inline void stats_hrdy(struct am335x_ctrl *ctrl, enum hrdy_phase phase,
+                              u64 waited_ns)
+{
+        unsigned int b = 0;
+
+        if(waited_ns)
+                b = min_t(unsigned int, ilog2(waited_ns) + 1, 
+                          AM335X_HRDY_HIST_BUCKETS - 1);
+        ctrl->stats.hrdy_hist[phase][b]++;
+}
+
+static u64 stats_begin(struct am335x_ctrl *ctrl)
+{
+        u64 now = ktime_get_ns();
+
+        if(ctrl->stats.last_end_ns)
+                ctrl->stats.idle_ns += now - ctrl->stats.last_end_ns;
+        return now;
+}
+
+static void stats_end(struct am335x_ctrl *ctrl, u64 start)
+{
+        u64 now = ktime_get_ns();
+
+        ctrl->stats.transactions++;
+        ctrl->stats.busy_ns += now - start;
+        ctrl->stats.last_end_ns = now;
+}
+
+static int stats_show(struct seq_file *s, void *unused)
+{
+        struct am335x_ctrl *ctrl = s->private;
+        struct am335x_stats *st = &ctrl->stats;
+        u64 written = st->dma_words + st->pio_words;
+        int b, p, last = 0;
+
+        seq_printf(s, "transactions: %llu\n", st->transactions);
+        seq_printf(s, "bytes_written: %llu\n", written * sizeof(short));
+        seq_printf(s, "bytes_read: %llu\n", st->words_read * sizeof(short));
+        seq_printf(s, "words_written: %llu\n", written);
+        seq_printf(s, "words_read: %llu\n", st->words_read);
+        seq_printf(s, "dma_words: %llu\n", st->dma_words);
+        seq_printf(s, "pio_words: %llu\n", st->pio_words);
+        seq_printf(s, "busy_ns: %llu\n", st->busy_ns);
+        seq_printf(s, "idle_ns: %llu\n", st->idle_ns);
+        seq_printf(s, "hrdy_timeouts: %llu\n", st->hrdy_timeouts);
+
+        for(b = 0; b < AM335X_HRDY_HIST_BUCKETS; b++)
+                for(p = 0; p < HRDY_PHASE_COUNT; p++)
+                        if(st->hrdy_hist[p][b])
+                                last = b;
+
+        seq_printf(s, "\n%12s %12s %12s %12s\n", "hrdy_ns(>=)", "pre_adr", 
+                   "pre_data", "word");
+        for(b = 0; b <= last; b++) {
+                seq_printf(s, "%12llu", (b) ? 1ull << (b - 1) : 0);
+                for(p = 0; p < HRDY_PHASE_COUNT; p++)
+                        seq_printf(s, " %12llu", st->hrdy_hist[p][b]);
+                seq_putc(s, '\n');
+        }
+
+        return 0;
+}
+
+DEFINE_SHOW_ATTRIBUTE(stats);
+
+static int stats_reset_set(void *data, u64 val)
+{
+        struct am335x_ctrl *ctrl = data;
+
+        memset(&ctrl->stats, 0, sizeof(ctrl->stats));
+        return 0;
+}
+
+DEFINE_DEBUGFS_ATTRIBUTE(stats_reset_fops, NULL, stats_reset_set, "%llu\n");
+
+////////////////////////////////////////////////////////////////////////////////
+// Timing solver
+
+static unsigned char ns_to_cycles(u32 ns, unsigned long rate, unsigned int div,
+                                  unsigned int min, unsigned int max, int *ret)
+{
+        u64 den = (u64)div * NSEC_PER_SEC;
+        u64 n = div64_u64((u64)ns * rate + den - 1, den);
+
+        if(n > max) {
+                *ret = -ERANGE;
+                return max;
+        }
+        return max_t(u64, n, min);
+}
+
+/*
+ * Converts a nanosecond spec into cycle counts for a memclk of rate / div. If
+ * a timing doesn't fit into its register field it is clamped and -ERANGE is
+ * returned.
+ */
+static int timings_from_ns(const struct am335x_lidd_timings_ns *ns, 
+                           unsigned long rate, unsigned int div, 
+                           struct am335x_lidd_timings *lt)
+{
+        int ret = 0;
+
+        lt->w_setup = ns_to_cycles(ns->w_setup, rate, div, 0, 31, &ret);
+        lt->w_strobe = ns_to_cycles(ns->w_strobe, rate, div, 1, 63, &ret);
+        lt->w_hold = ns_to_cycles(ns->w_hold, rate, div, 1, 15, &ret);
+        lt->r_setup = ns_to_cycles(ns->r_setup, rate, div, 0, 31, &ret);
+        lt->r_strobe = ns_to_cycles(ns->r_strobe, rate, div, 1, 63, &ret);
+        lt->r_hold = ns_to_cycles(ns->r_hold, rate, div, 1, 15, &ret);
+        lt->ta = ns_to_cycles(ns->ta, rate, div, 0, 3, &ret);
+        return ret;
+}
+
+// the turnaround delay is not incurred between two reads
+static unsigned int write_cycles(const struct am335x_lidd_timings *lt)
+{
+        return lt->w_setup + lt->w_strobe + lt->w_hold + lt->ta;
+}
+
+static unsigned int read_cycles(const struct am335x_lidd_timings *lt)
+{
+        return lt->r_setup + lt->r_strobe + lt->r_hold;
+}
+
+static unsigned long words_per_sec(unsigned long rate, unsigned int div,
+                                   unsigned int cycles)
+{
+        return rate / (div * cycles);
+}
+
+/*
+ * Time in ps to write one word with every profile given in nanoseconds and
+ * to read one word with the register profile.
+ */
+static u64 timings_ns_cost(struct am335x_ctrl *ctrl, unsigned long rate,
+                           unsigned int div)
+{
+        struct am335x_lidd_timings lt;
+        unsigned int cycles = 0;
+        int ld;
+
+        for(ld = LIDD_CS0; ld <= LIDD_CS1; ld++) {
+                if(!test_bit(ld, &ctrl->timings_ns_set))
+                        continue;
+                if(timings_from_ns(&ctrl->timings_ns[ld], rate, div, &lt))
+                        return U64_MAX;
+
+                cycles += write_cycles(&lt);
+                if(ld == LIDD_CS0)
+                        cycles += read_cycles(&lt);
+        }
+
+        return div64_u64((u64)cycles * div * NSEC_PER_SEC * 1000, rate);
+}
+
+/*
+ * Recomputes the cycle counts of the profiles given in nanoseconds for the 
+ * memclk rate / clk_div. The timing lock has to be held.
+ */
+static void timings_ns_apply(struct am335x_ctrl *ctrl, unsigned long rate)
+{
+        struct am335x_lidd_timings lt;
+        unsigned int div = am335x_shadow_get_clkdiv(&ctrl->regs);
+        int ld;
+
+        for(ld = LIDD_CS0; ld <= LIDD_CS1; ld++) {
+                if(!test_bit(ld, &ctrl->timings_ns_set))
+                        continue;
+                if(timings_from_ns(&ctrl->timings_ns[ld], rate, div, &lt))
+                        pr_warn("%s: CS%d timings don't fit at %lu Hz / %u!\n",
+                                THIS_MODULE->name, ld, rate, div);
+                am335x_shadow_set_lidd_timings(&ctrl->regs, ld, &lt);
+        }
+        am335x_shadow_flush(&ctrl->regs);
+}
+
+/*
+ * Picks the clock rate and divider with the lowest cost that meets all 
+ * nanosecond specs. Every rate the clock can provide in the sysfs range is
+ * tried. The timing lock has to be held.
+ */
+static int timings_ns_optimize(struct am335x_ctrl *ctrl)
+{
+        unsigned long f, best_rate = 0;
+        unsigned int div, best_div = 0;
+        u64 cost, best = U64_MAX;
+        long rate, last = 0;
+        int ret;
+
+        if(!ctrl->timings_ns_set)
+                return 0;
+
+        for(f = CLK_FREQ_MIN; f <= CLK_FREQ_MAX; f += CLK_FREQ_STEP) {
+                rate = clk_round_rate(ctrl->hw_clk, f);
+                if(rate <= 0 || rate == last || rate < CLK_FREQ_MIN || 
+                   rate > CLK_FREQ_MAX)
+                        continue;
+                last = rate;
+
+                for(div = 1; div <= CLK_DIV_MAX; div++) {
+                        // a single memclk cycle already takes too long
+                        if(div64_u64((u64)div * NSEC_PER_SEC * 1000, rate) >= 
+                           best)
+                                break;
+
+                        cost = timings_ns_cost(ctrl, rate, div);
+                        if(cost < best) {
+                                best = cost;
+                                best_rate = rate;
+                                best_div = div;
+                        }
+                }
+        }
+
+        if(!best_rate)
+                return -ERANGE;
+
+        ret = clk_set_rate(ctrl->hw_clk, best_rate);
+        if(ret)
+                return ret;
+
+        am335x_shadow_set_clkdiv(&ctrl->regs, best_div);
+        timings_ns_apply(ctrl, clk_get_rate(ctrl->hw_clk));
+        return 0;
+}
+
+/*
+ * Keeps transfers off the bus while the clock or the timings change. Has to
+ * be taken before the timing lock.
+ */
+static int timings_bus_lock(struct am335x_ctrl *ctrl)
+{
+        if(!ctrl->ctrl.bus_lock)
+                return 0;
+        return ctrl->ctrl.bus_lock(ctrl->ctrl.bus_data);
+}
+
+static void timings_bus_unlock(struct am335x_ctrl *ctrl)
+{
+        if(ctrl->ctrl.bus_unlock)
+                ctrl->ctrl.bus_unlock(ctrl->ctrl.bus_data);
+}
+
+static int timings_clk_notify(struct notifier_block *nb, unsigned long event,
+                              void *data)
+{
+        struct am335x_ctrl *ctrl = container_of(nb, struct am335x_ctrl, clk_nb);
+        struct clk_notifier_data *nd = data;
+
+        if(event != POST_RATE_CHANGE)
+                return NOTIFY_DONE;
+
+        // the optimizer applies the timings itself
+        if(!mutex_trylock(&ctrl->timing_lock))
+                return NOTIFY_OK;
+
+        timings_ns_apply(ctrl, nd->new_rate);
+        mutex_unlock(&ctrl->timing_lock);
+        return NOTIFY_OK;
+}
+
+static void timings_ns_init(struct am335x_ctrl *ctrl, struct device_node *np)
+{
+        static const char * const props[] = { 
+                AM335X_TIMINGS_NS_PROP, 
+                AM335X_PIXEL_TIMINGS_NS_PROP,
+        };
+        int ld, ret;
+
+        mutex_init(&ctrl->timing_lock);
+        ctrl->timings_ns_set = 0;
+
+        for(ld = LIDD_CS0; ld <= LIDD_CS1; ld++) {
+                if(!of_property_read_u32_array(np, props[ld], 
+                                               (u32 *)&ctrl->timings_ns[ld],
+                                               AM335X_TIMINGS_NS_COUNT))
+                        set_bit(ld, &ctrl->timings_ns_set);
+        }
+
+        mutex_lock(&ctrl->timing_lock);
+        ret = timings_ns_optimize(ctrl);
+        mutex_unlock(&ctrl->timing_lock);
+        if(ret)
+                pr_warn("%s: No clock setting meets the timings (%d)!\n",
+                        THIS_MODULE->name, ret);
+
+        ctrl->clk_nb.notifier_call = timings_clk_notify;
+        if(clk_notifier_register(ctrl->hw_clk, &ctrl->clk_nb))
+                pr_warn("%s: Timings won't follow clock changes!\n",
+                        THIS_MODULE->name);
+}
+
+static ssize_t timings_ns_show(struct am335x_ctrl *ctrl, enum lidd_device ld,
+                               char *buf)
+{
+        struct am335x_lidd_timings_ns *ns = &ctrl->timings_ns[ld];
+
+        if(!test_bit(ld, &ctrl->timings_ns_set))
+                return sprintf(buf, "none\n");
+
+        return sprintf(buf, "%u %u %u %u %u %u %u\n", ns->w_setup, 
+                       ns->w_strobe, ns->w_hold, ns->r_setup, ns->r_strobe,
+                       ns->r_hold, ns->ta);
+}
+
+static ssize_t timings_ns_store(struct am335x_ctrl *ctrl, enum lidd_device ld,
+                                const char *buf, size_t count)
+{
+        struct am335x_lidd_timings_ns ns, old_ns;
+        int ret, old_set;
+
+        ret = timings_bus_lock(ctrl);
+        if(ret)
+                return ret;
+        mutex_lock(&ctrl->timing_lock);
+
+        old_ns = ctrl->timings_ns[ld];
+        old_set = test_bit(ld, &ctrl->timings_ns_set);
+        if(sysfs_streq(buf, "none")) {
+                clear_bit(ld, &ctrl->timings_ns_set);
+        } else {
+                if(sscanf(buf, "%u %u %u %u %u %u %u", &ns.w_setup, 
+                          &ns.w_strobe, &ns.w_hold, &ns.r_setup, &ns.r_strobe,
+                          &ns.r_hold, &ns.ta) != AM335X_TIMINGS_NS_COUNT) {
+                        ret = -EINVAL;
+                        goto unlock;
+                }
+                ctrl->timings_ns[ld] = ns;
+                set_bit(ld, &ctrl->timings_ns_set);
+        }
+
+        // nothing has been applied if that fails, keep the active spec
+        ret = timings_ns_optimize(ctrl);
+        if(ret) {
+                ctrl->timings_ns[ld] = old_ns;
+                if(old_set)
+                        set_bit(ld, &ctrl->timings_ns_set);
+                else
+                        clear_bit(ld, &ctrl->timings_ns_set);
+        }
+
+unlock:
+        mutex_unlock(&ctrl->timing_lock);
+        timings_bus_unlock(ctrl);
+        return (ret) ? ret : count;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // SysFS implementations
 
@@ -52,9 +431,13 @@ static ssize_t clk_freq_store(struct device *dev, struct device_attribute *attr,
         if(ret)
                 return ret;
 
-        clk_freq = param_clamp(clk_freq, 25000000ul, 300000000ul);
+        clk_freq = param_clamp(clk_freq, CLK_FREQ_MIN, CLK_FREQ_MAX);
         
+        ret = timings_bus_lock(ctrl);
+        if(ret)
+                return ret;
         ret = clk_set_rate(ctrl->hw_clk, clk_freq);
+        timings_bus_unlock(ctrl);
         if(ret)
                 return ret;
 
@@ -72,7 +455,7 @@ static ssize_t clk_div_show(struct device *dev,
 
         ctrl = timing_dev_to_ctrl(dev);
 
-        clk_div = am335x_lcdc_get_clkdiv(ctrl->reg_base_addr);
+        clk_div = am335x_shadow_get_clkdiv(&ctrl->regs);
         return sprintf(buf, "%d\n", clk_div);
 }
 
@@ -88,9 +471,17 @@ static ssize_t clk_div_store(struct device *dev,
         if(ret)
                 return ret;
 
-        clk_div = param_clamp(clk_div, 1, 255);
+        clk_div = param_clamp(clk_div, 1, CLK_DIV_MAX);
         
-        am335x_lcdc_set_clkdiv(ctrl->reg_base_addr, clk_div);
+        ret = timings_bus_lock(ctrl);
+        if(ret)
+                return ret;
+        mutex_lock(&ctrl->timing_lock);
+        am335x_shadow_set_clkdiv(&ctrl->regs, clk_div);
+        am335x_shadow_flush(&ctrl->regs);
+        timings_ns_apply(ctrl, clk_get_rate(ctrl->hw_clk));
+        mutex_unlock(&ctrl->timing_lock);
+        timings_bus_unlock(ctrl);
         return count;
 }
 
@@ -102,7 +493,7 @@ static ssize_t w_su_show(struct device *dev,
 {
         int w_su;
         struct am335x_ctrl *ctrl = timing_dev_to_ctrl(dev);
-        w_su = am335x_get_lidd_w_su(ctrl->hw_res, LIDD_CS0);
+        w_su = am335x_shadow_get_lidd_timings(&ctrl->regs, LIDD_CS0).w_setup;
         return sprintf(buf, "%d\n", w_su);//, w_su_cs1);
 }
 
@@ -118,7 +509,8 @@ static ssize_t w_su_store(struct device *dev, struct device_attribute *attr,
 
         w_su = param_clamp(w_su, 0, 31);
 
-        am335x_set_lidd_w_su(ctrl->reg_base_addr, LIDD_CS0, w_su);
+        am335x_shadow_set_lidd_w_su(&ctrl->regs, LIDD_CS0, w_su);
+        am335x_shadow_flush(&ctrl->regs);
         return count;
 }
 
@@ -131,7 +523,8 @@ static ssize_t w_strobe_show(struct device *dev,
         int w_strobe;
         struct am335x_ctrl *ctrl = timing_dev_to_ctrl(dev);
 
-        w_strobe = am335x_get_lidd_w_strobe(ctrl->reg_base_addr, LIDD_CS0);
+        w_strobe = am335x_shadow_get_lidd_timings(&ctrl->regs, 
+                                                  LIDD_CS0).w_strobe;
         return sprintf(buf, "%d\n", w_strobe);
 }
 
@@ -147,7 +540,8 @@ static ssize_t w_strobe_store(struct device *dev, struct device_attribute *attr,
 
         w_strobe = param_clamp(w_strobe, 1, 63);
 
-        am335x_set_lidd_w_strobe(ctrl->reg_base_addr, LIDD_CS0, w_strobe);
+        am335x_shadow_set_lidd_w_strobe(&ctrl->regs, LIDD_CS0, w_strobe);
+        am335x_shadow_flush(&ctrl->regs);
         return count;
 }
 
@@ -160,7 +554,7 @@ static ssize_t w_hold_show(struct device *dev,
         int w_hold;
         struct am335x_ctrl *ctrl = timing_dev_to_ctrl(dev);
         
-        w_hold = am335x_get_lidd_w_hold(ctrl->reg_base_addr, LIDD_CS0);
+        w_hold = am335x_shadow_get_lidd_timings(&ctrl->regs, LIDD_CS0).w_hold;
         return sprintf(buf, "%d\n", w_hold);
 }
 
@@ -176,7 +570,8 @@ static ssize_t w_hold_store(struct device *dev, struct device_attribute *attr,
 
         w_hold = param_clamp(w_hold, 1, 15);
 
-        am335x_set_lidd_w_hold(ctrl->reg_base_addr, LIDD_CS0, w_hold);
+        am335x_shadow_set_lidd_w_hold(&ctrl->regs, LIDD_CS0, w_hold);
+        am335x_shadow_flush(&ctrl->regs);
         return count;
 }
 
@@ -189,7 +584,7 @@ static ssize_t r_su_show(struct device *dev,
         int r_su;
         struct am335x_ctrl *ctrl = timing_dev_to_ctrl(dev);
 
-        r_su = am335x_get_lidd_r_su(ctrl->reg_base_addr, LIDD_CS0);
+        r_su = am335x_shadow_get_lidd_timings(&ctrl->regs, LIDD_CS0).r_setup;
         return sprintf(buf, "%d\n", r_su);
 }
 
@@ -205,7 +600,8 @@ static ssize_t r_su_store(struct device *dev, struct device_attribute *attr,
 
         r_su = param_clamp(r_su, 0, 31);
 
-        am335x_set_lidd_r_su(ctrl->reg_base_addr, LIDD_CS0, r_su);
+        am335x_shadow_set_lidd_r_su(&ctrl->regs, LIDD_CS0, r_su);
+        am335x_shadow_flush(&ctrl->regs);
         return count;
 }
 
@@ -218,7 +614,8 @@ static ssize_t r_strobe_show(struct device *dev,
         int r_strobe;
         struct am335x_ctrl *ctrl = timing_dev_to_ctrl(dev);
 
-        r_strobe = am335x_get_lidd_r_strobe(ctrl->reg_base_addr, LIDD_CS0);
+        r_strobe = am335x_shadow_get_lidd_timings(&ctrl->regs, 
+                                                  LIDD_CS0).r_strobe;
         return sprintf(buf, "%d\n", r_strobe);
 }
 
@@ -234,7 +631,8 @@ static ssize_t r_strobe_store(struct device *dev, struct device_attribute *attr,
 
         r_strobe = param_clamp(r_strobe, 1, 63);
 
-        am335x_set_lidd_r_strobe(ctrl->reg_base_addr, LIDD_CS0, r_strobe);
+        am335x_shadow_set_lidd_r_strobe(&ctrl->regs, LIDD_CS0, r_strobe);
+        am335x_shadow_flush(&ctrl->regs);
         return count;
 }
 
@@ -247,7 +645,7 @@ static ssize_t r_hold_show(struct device *dev,
         int r_hold;
         struct am335x_ctrl *ctrl = timing_dev_to_ctrl(dev);
 
-        r_hold = am335x_get_lidd_r_hold(ctrl->reg_base_addr, LIDD_CS0);
+        r_hold = am335x_shadow_get_lidd_timings(&ctrl->regs, LIDD_CS0).r_hold;
         return sprintf(buf, "%d\n", r_hold);
 }
 
@@ -263,7 +661,8 @@ static ssize_t r_hold_store(struct device *dev, struct device_attribute *attr,
 
         r_hold = param_clamp(r_hold, 1, 15);
 
-        am335x_set_lidd_r_hold(ctrl->reg_base_addr, LIDD_CS0, r_hold);
+        am335x_shadow_set_lidd_r_hold(&ctrl->regs, LIDD_CS0, r_hold);
+        am335x_shadow_flush(&ctrl->regs);
         return count;
 }
 
@@ -276,7 +675,7 @@ static ssize_t cs_delay_show(struct device *dev, struct
         int cs_delay;
         struct am335x_ctrl *ctrl = timing_dev_to_ctrl(dev);
 
-        cs_delay = am335x_get_lidd_ta(ctrl->reg_base_addr, LIDD_CS0);
+        cs_delay = am335x_shadow_get_lidd_timings(&ctrl->regs, LIDD_CS0).ta;
         return sprintf(buf, "%d\n", cs_delay);
 }
 
@@ -292,192 +691,476 @@ static ssize_t cs_delay_store(struct device *dev, struct device_attribute *attr,
 
         cs_delay = param_clamp(cs_delay, 0, 3);
 
-        am335x_set_lidd_ta(ctrl->reg_base_addr, LIDD_CS0, cs_delay);
+        am335x_shadow_set_lidd_ta(&ctrl->regs, LIDD_CS0, cs_delay);
+        am335x_shadow_flush(&ctrl->regs);
         return count;
 }
 
 static DEVICE_ATTR_RW(cs_delay);
 
-static struct attribute *am335x_timings_attrs[] = {
-        &dev_attr_clk_freq.attr,
-        &dev_attr_clk_div.attr,
-        &dev_attr_w_su.attr,
-        &dev_attr_w_strobe.attr,
-        &dev_attr_w_hold.attr,
-        &dev_attr_r_su.attr,
-        &dev_attr_r_strobe.attr,
-        &dev_attr_r_hold.attr,
-        &dev_attr_cs_delay.attr,
-        NULL,
-};
-
-ATTRIBUTE_GROUPS(am335x_timings);
-
-static void timings_dev_release(struct device *dev)
+// hrdy_spin_us
+static ssize_t hrdy_spin_us_show(struct device *dev, 
+                                 struct device_attribute *attr, char *buf)
 {
-        memset(dev, 0, sizeof(*dev));
+        struct am335x_ctrl *ctrl = timing_dev_to_ctrl(dev);
+        return sprintf(buf, "%u\n", 
+                       (unsigned int)(READ_ONCE(ctrl->hrdy_spin_max_ns) / 
+                                      NSEC_PER_USEC));
 }
 
-static int am335x_timings_sysfs_register(struct am335x_ctrl *ctrl, struct class *c)
+static ssize_t hrdy_spin_us_store(struct device *dev, 
+                                  struct device_attribute *attr,
+                                  const char *buf, size_t count)
 {
         int ret;
-        ctrl->timing_dev.class = c;
-        ctrl->timing_dev.groups = am335x_timings_groups;
-        ctrl->timing_dev.release = timings_dev_release;
+        unsigned int hrdy_spin_us;
+        struct am335x_ctrl *ctrl = timing_dev_to_ctrl(dev);
 
-        ret = dev_set_name(&ctrl->timing_dev, TIMING_DEVICE_NAME);
-        if(ret)
+        ret = kstrtouint(buf, 10, &hrdy_spin_us);
+        if(ret < 0)
                 return ret;
 
-        ret = device_register(&ctrl->timing_dev);
-        if(ret) 
-                return ret;
-        else
-                return 0;
+        hrdy_spin_us = param_clamp(hrdy_spin_us, 0, HRDY_SPIN_MAX_US);
+
+        // the waiters read these without a lock
+        WRITE_ONCE(ctrl->hrdy_spin_max_ns, hrdy_spin_us * NSEC_PER_USEC);
+        WRITE_ONCE(ctrl->hrdy_spin_ns, hrdy_spin_us * NSEC_PER_USEC);
+        WRITE_ONCE(ctrl->hrdy_wait_avg_ns, 0);
+        return count;
 }
 
-static void am335x_timings_sysfs_unregister(struct am335x_ctrl *ctrl)
+static DEVICE_ATTR_RW(hrdy_spin_us);
+
+// timings_ns
+static ssize_t timings_ns_show_cs0(struct device *dev, 
+                                   struct device_attribute *attr, char *buf)
 {
-        device_unregister(&ctrl->timing_dev);
+        return timings_ns_show(timing_dev_to_ctrl(dev), LIDD_CS0, buf);
 }
 
-/* polarites */
+static ssize_t timings_ns_store_cs0(struct device *dev, 
+                                    struct device_attribute *attr,
+                                    const char *buf, size_t count)
+{
+        return timings_ns_store(timing_dev_to_ctrl(dev), LIDD_CS0, buf, count);
+}
 
-// cs0_e0 pol
-static ssize_t cs0_e0_pol_show(struct device *dev, 
-                               struct device_attribute *attr, char *buf)
+static struct device_attribute dev_attr_timings_ns = 
+        __ATTR(timings_ns, 0644, timings_ns_show_cs0, timings_ns_store_cs0);
+
+// write_words_per_sec
+static ssize_t write_words_per_sec_show(struct device *dev, 
+                                        struct device_attribute *attr, 
+                                        char *buf)
 {
-        int cs0_e0_pol;
-        struct am335x_ctrl *ctrl = pol_dev_to_ctrl(dev);
+        struct am335x_ctrl *ctrl = timing_dev_to_ctrl(dev);
+        struct am335x_lidd_timings lt;
 
-        cs0_e0_pol = am335x_get_cs0_e0_pol(ctrl->reg_base_addr);
-        return sprintf(buf, "%d\n", cs0_e0_pol);
+        lt = am335x_shadow_get_lidd_timings(&ctrl->regs, LIDD_CS0);
+        return sprintf(buf, "%lu\n", words_per_sec(clk_get_rate(ctrl->hw_clk),
+                       am335x_shadow_get_clkdiv(&ctrl->regs), 
+                       write_cycles(&lt)));
 }
 
-static ssize_t cs0_e0_pol_store(struct device *dev, 
-                                struct device_attribute *attr,
-                                const char *buf, size_t count)
-{
-        int ret, cs0_e0_pol;
-        struct am335x_ctrl *ctrl = pol_dev_to_ctrl(dev);
+static DEVICE_ATTR_RO(write_words_per_sec);
 
-        ret = kstrtoint(buf, 10, &cs0_e0_pol);
-        if(ret < 0) 
-                return ret;
+// read_words_per_sec
+static ssize_t read_words_per_sec_show(struct device *dev, 
+                                       struct device_attribute *attr, 
+                                       char *buf)
+{
+        struct am335x_ctrl *ctrl = timing_dev_to_ctrl(dev);
+        struct am335x_lidd_timings lt;
 
-        am335x_set_cs0_e0_pol(ctrl->reg_base_addr, cs0_e0_pol);
-        return count;
+        lt = am335x_shadow_get_lidd_timings(&ctrl->regs, LIDD_CS0);
+        return sprintf(buf, "%lu\n", words_per_sec(clk_get_rate(ctrl->hw_clk),
+                       am335x_shadow_get_clkdiv(&ctrl->regs), 
+                       read_cycles(&lt)));
 }
 
-static DEVICE_ATTR_RW(cs0_e0_pol);
+static DEVICE_ATTR_RO(read_words_per_sec);
 
-// cs1_e1 pol
-static ssize_t cs1_e1_pol_show(struct device *dev, 
+// pixel w_su
+static ssize_t pixel_w_su_show(struct device *dev, 
                                struct device_attribute *attr, char *buf)
 {
-        int cs1_e1_pol;
-        struct am335x_ctrl *ctrl = pol_dev_to_ctrl(dev);
+        int w_su;
+        struct am335x_ctrl *ctrl = timing_dev_to_ctrl(dev);
 
-        cs1_e1_pol = am335x_get_cs1_e1_pol(ctrl->reg_base_addr);
-        return sprintf(buf, "%d\n", cs1_e1_pol);
+        w_su = am335x_shadow_get_lidd_timings(&ctrl->regs, LIDD_CS1).w_setup;
+        return sprintf(buf, "%d\n", w_su);
 }
 
-static ssize_t cs1_e1_pol_store(struct device *dev, 
+static ssize_t pixel_w_su_store(struct device *dev, 
                                 struct device_attribute *attr,
                                 const char *buf, size_t count)
 {
-        int ret, cs1_e1_pol;
-        struct am335x_ctrl *ctrl = pol_dev_to_ctrl(dev);
+        int ret, w_su;
+        struct am335x_ctrl *ctrl = timing_dev_to_ctrl(dev);
 
-        ret = kstrtoint(buf, 10, &cs1_e1_pol);
+        ret = kstrtoint(buf, 10, &w_su);
         if(ret < 0) 
                 return ret;
 
-        am335x_set_cs1_e1_pol(ctrl->reg_base_addr, cs1_e1_pol);
+        w_su = param_clamp(w_su, 0, 31);
+
+        am335x_shadow_set_lidd_w_su(&ctrl->regs, LIDD_CS1, w_su);
+        am335x_shadow_flush(&ctrl->regs);
         return count;
 }
 
-static DEVICE_ATTR_RW(cs1_e1_pol);
+static struct device_attribute dev_attr_pixel_w_su = 
+        __ATTR(w_su, 0644, pixel_w_su_show, pixel_w_su_store);
 
-// ws_dir pol
-static ssize_t ws_dir_pol_show(struct device *dev, 
-                               struct device_attribute *attr, char *buf)
+// pixel w_strobe
+static ssize_t pixel_w_strobe_show(struct device *dev, 
+                                   struct device_attribute *attr, char *buf)
 {
-        int ws_dir_pol;
-        struct am335x_ctrl *ctrl = pol_dev_to_ctrl(dev);
+        int w_strobe;
+        struct am335x_ctrl *ctrl = timing_dev_to_ctrl(dev);
 
-        ws_dir_pol = am335x_get_ws_dir_pol(ctrl->reg_base_addr);
-        return sprintf(buf, "%d\n", ws_dir_pol);
+        w_strobe = am335x_shadow_get_lidd_timings(&ctrl->regs, 
+                                                  LIDD_CS1).w_strobe;
+        return sprintf(buf, "%d\n", w_strobe);
 }
 
-static ssize_t ws_dir_pol_store(struct device *dev, 
-                                struct device_attribute *attr,
-                                const char *buf, size_t count)
+static ssize_t pixel_w_strobe_store(struct device *dev, 
+                                    struct device_attribute *attr,
+                                    const char *buf, size_t count)
 {
-        int ret, ws_dir_pol;
-        struct am335x_ctrl *ctrl = pol_dev_to_ctrl(dev);
+        int ret, w_strobe;
+        struct am335x_ctrl *ctrl = timing_dev_to_ctrl(dev);
 
-        ret = kstrtoint(buf, 10, &ws_dir_pol);
+        ret = kstrtoint(buf, 10, &w_strobe);
         if(ret < 0) 
                 return ret;
 
-        am335x_set_ws_dir_pol(ctrl->reg_base_addr, ws_dir_pol);
+        w_strobe = param_clamp(w_strobe, 1, 63);
+
+        am335x_shadow_set_lidd_w_strobe(&ctrl->regs, LIDD_CS1, w_strobe);
+        am335x_shadow_flush(&ctrl->regs);
         return count;
 }
 
-static DEVICE_ATTR_RW(ws_dir_pol);
+static struct device_attribute dev_attr_pixel_w_strobe = 
+        __ATTR(w_strobe, 0644, pixel_w_strobe_show, pixel_w_strobe_store);
 
-// rs_en pol
-static ssize_t rs_en_pol_show(struct device *dev, 
-                              struct device_attribute *attr, char *buf)
+// pixel w_hold
+static ssize_t pixel_w_hold_show(struct device *dev, 
+                                 struct device_attribute *attr, char *buf)
 {
-        int rs_en_pol;
-        struct am335x_ctrl *ctrl = pol_dev_to_ctrl(dev);
+        int w_hold;
+        struct am335x_ctrl *ctrl = timing_dev_to_ctrl(dev);
 
-        rs_en_pol = am335x_get_ws_dir_pol(ctrl->reg_base_addr);
-        return sprintf(buf, "%d\n", rs_en_pol);
+        w_hold = am335x_shadow_get_lidd_timings(&ctrl->regs, LIDD_CS1).w_hold;
+        return sprintf(buf, "%d\n", w_hold);
 }
 
-static ssize_t rs_en_pol_store(struct device *dev, 
-                               struct device_attribute *attr,
-                               const char *buf, size_t count)
+static ssize_t pixel_w_hold_store(struct device *dev, 
+                                  struct device_attribute *attr,
+                                  const char *buf, size_t count)
 {
-        int ret, rs_en_pol;
-        struct am335x_ctrl *ctrl = pol_dev_to_ctrl(dev);
+        int ret, w_hold;
+        struct am335x_ctrl *ctrl = timing_dev_to_ctrl(dev);
 
-        ret = kstrtoint(buf, 10, &rs_en_pol);
+        ret = kstrtoint(buf, 10, &w_hold);
         if(ret < 0) 
                 return ret;
 
-        am335x_set_rs_en_pol(ctrl->reg_base_addr, rs_en_pol);
+        w_hold = param_clamp(w_hold, 1, 15);
+
+        am335x_shadow_set_lidd_w_hold(&ctrl->regs, LIDD_CS1, w_hold);
+        am335x_shadow_flush(&ctrl->regs);
         return count;
 }
 
-static DEVICE_ATTR_RW(rs_en_pol);
+static struct device_attribute dev_attr_pixel_w_hold = 
+        __ATTR(w_hold, 0644, pixel_w_hold_show, pixel_w_hold_store);
 
-// ale pol
-static ssize_t ale_pol_show(struct device *dev, 
-                            struct device_attribute *attr, char *buf)
+// pixel cs_delay
+static ssize_t pixel_cs_delay_show(struct device *dev, 
+                                   struct device_attribute *attr, char *buf)
 {
-        int ale_pol;
-        struct am335x_ctrl *ctrl = pol_dev_to_ctrl(dev);
+        int cs_delay;
+        struct am335x_ctrl *ctrl = timing_dev_to_ctrl(dev);
 
-        ale_pol = am335x_get_ale_pol(ctrl->reg_base_addr);
-        return sprintf(buf, "%d\n", ale_pol);
+        cs_delay = am335x_shadow_get_lidd_timings(&ctrl->regs, LIDD_CS1).ta;
+        return sprintf(buf, "%d\n", cs_delay);
 }
 
-static ssize_t ale_pol_store(struct device *dev, 
-                             struct device_attribute *attr,
-                             const char *buf, size_t count)
+static ssize_t pixel_cs_delay_store(struct device *dev, 
+                                    struct device_attribute *attr,
+                                    const char *buf, size_t count)
 {
-        int ret, ale_pol;
-        struct am335x_ctrl *ctrl = pol_dev_to_ctrl(dev);
+        int ret, cs_delay;
+        struct am335x_ctrl *ctrl = timing_dev_to_ctrl(dev);
+
+        ret = kstrtoint(buf, 10, &cs_delay);
+        if(ret < 0) 
+                return ret;
+
+        cs_delay = param_clamp(cs_delay, 0, 3);
+
+        am335x_shadow_set_lidd_ta(&ctrl->regs, LIDD_CS1, cs_delay);
+        am335x_shadow_flush(&ctrl->regs);
+        return count;
+}
+
+static struct device_attribute dev_attr_pixel_cs_delay = 
+        __ATTR(cs_delay, 0644, pixel_cs_delay_show, pixel_cs_delay_store);
+
+// pixel timings_ns
+static ssize_t timings_ns_show_cs1(struct device *dev, 
+                                   struct device_attribute *attr, char *buf)
+{
+        return timings_ns_show(timing_dev_to_ctrl(dev), LIDD_CS1, buf);
+}
+
+static ssize_t timings_ns_store_cs1(struct device *dev, 
+                                    struct device_attribute *attr,
+                                    const char *buf, size_t count)
+{
+        return timings_ns_store(timing_dev_to_ctrl(dev), LIDD_CS1, buf, count);
+}
+
+static struct device_attribute dev_attr_pixel_timings_ns = 
+        __ATTR(timings_ns, 0644, timings_ns_show_cs1, timings_ns_store_cs1);
+
+// pixel write_words_per_sec
+static ssize_t pixel_write_words_per_sec_show(struct device *dev, 
+                                              struct device_attribute *attr, 
+                                              char *buf)
+{
+        struct am335x_ctrl *ctrl = timing_dev_to_ctrl(dev);
+        struct am335x_lidd_timings lt;
+
+        lt = am335x_shadow_get_lidd_timings(&ctrl->regs, LIDD_CS1);
+        return sprintf(buf, "%lu\n", words_per_sec(clk_get_rate(ctrl->hw_clk),
+                       am335x_shadow_get_clkdiv(&ctrl->regs), 
+                       write_cycles(&lt)));
+}
+
+static struct device_attribute dev_attr_pixel_write_words_per_sec = 
+        __ATTR(write_words_per_sec, 0444, pixel_write_words_per_sec_show, NULL);
+
+static struct attribute *am335x_timings_attrs[] = {
+        &dev_attr_clk_freq.attr,
+        &dev_attr_clk_div.attr,
+        &dev_attr_w_su.attr,
+        &dev_attr_w_strobe.attr,
+        &dev_attr_w_hold.attr,
+        &dev_attr_r_su.attr,
+        &dev_attr_r_strobe.attr,
+        &dev_attr_r_hold.attr,
+        &dev_attr_cs_delay.attr,
+        &dev_attr_hrdy_spin_us.attr,
+        &dev_attr_timings_ns.attr,
+        &dev_attr_write_words_per_sec.attr,
+        &dev_attr_read_words_per_sec.attr,
+        NULL,
+};
+
+static struct attribute *am335x_pixel_timings_attrs[] = {
+        &dev_attr_pixel_w_su.attr,
+        &dev_attr_pixel_w_strobe.attr,
+        &dev_attr_pixel_w_hold.attr,
+        &dev_attr_pixel_cs_delay.attr,
+        &dev_attr_pixel_timings_ns.attr,
+        &dev_attr_pixel_write_words_per_sec.attr,
+        NULL,
+};
+
+static const struct attribute_group am335x_timings_group = {
+        .attrs = am335x_timings_attrs,
+};
+
+static const struct attribute_group am335x_pixel_timings_group = {
+        .name = "pixel",
+        .attrs = am335x_pixel_timings_attrs,
+};
+
+static const struct attribute_group *am335x_timings_groups[] = {
+        &am335x_timings_group,
+        &am335x_pixel_timings_group,
+        NULL,
+};
+
+static void timings_dev_release(struct device *dev)
+{
+        memset(dev, 0, sizeof(*dev));
+}
+
+static int am335x_timings_sysfs_register(struct am335x_ctrl *ctrl, 
+                                        struct device *parent)
+{
+        int ret;
+        ctrl->timing_dev.parent = parent;
+        ctrl->timing_dev.groups = am335x_timings_groups;
+        ctrl->timing_dev.release = timings_dev_release;
+
+        ret = dev_set_name(&ctrl->timing_dev, TIMING_DEVICE_NAME);
+        if(ret)
+                return ret;
+
+        ret = device_register(&ctrl->timing_dev);
+        if(ret) 
+                return ret;
+        else
+                return 0;
+}
+
+static void am335x_timings_sysfs_unregister(struct am335x_ctrl *ctrl)
+{
+        device_unregister(&ctrl->timing_dev);
+}
+
+/* polarites */
+
+// cs0_e0 pol
+static ssize_t cs0_e0_pol_show(struct device *dev, 
+                               struct device_attribute *attr, char *buf)
+{
+        int cs0_e0_pol;
+        struct am335x_ctrl *ctrl = pol_dev_to_ctrl(dev);
+
+        cs0_e0_pol = am335x_shadow_get_lidd_pols(&ctrl->regs).cs0_e0_pol;
+        return sprintf(buf, "%d\n", cs0_e0_pol);
+}
+
+static ssize_t cs0_e0_pol_store(struct device *dev, 
+                                struct device_attribute *attr,
+                                const char *buf, size_t count)
+{
+        int ret, cs0_e0_pol;
+        struct am335x_ctrl *ctrl = pol_dev_to_ctrl(dev);
+
+        ret = kstrtoint(buf, 10, &cs0_e0_pol);
+        if(ret < 0) 
+                return ret;
+
+        am335x_shadow_set_lidd_ctrl_bit(&ctrl->regs, AM335X_CS0_E0_POL_OFFS, 
+                                        cs0_e0_pol);
+        am335x_shadow_flush(&ctrl->regs);
+        return count;
+}
+
+static DEVICE_ATTR_RW(cs0_e0_pol);
+
+// cs1_e1 pol
+static ssize_t cs1_e1_pol_show(struct device *dev, 
+                               struct device_attribute *attr, char *buf)
+{
+        int cs1_e1_pol;
+        struct am335x_ctrl *ctrl = pol_dev_to_ctrl(dev);
+
+        cs1_e1_pol = am335x_shadow_get_lidd_pols(&ctrl->regs).cs1_e1_pol;
+        return sprintf(buf, "%d\n", cs1_e1_pol);
+}
+
+static ssize_t cs1_e1_pol_store(struct device *dev, 
+                                struct device_attribute *attr,
+                                const char *buf, size_t count)
+{
+        int ret, cs1_e1_pol;
+        struct am335x_ctrl *ctrl = pol_dev_to_ctrl(dev);
+
+        ret = kstrtoint(buf, 10, &cs1_e1_pol);
+        if(ret < 0) 
+                return ret;
+
+        am335x_shadow_set_lidd_ctrl_bit(&ctrl->regs, AM335X_CS1_E1_POL_OFFS, 
+                                        cs1_e1_pol);
+        am335x_shadow_flush(&ctrl->regs);
+        return count;
+}
+
+static DEVICE_ATTR_RW(cs1_e1_pol);
+
+// ws_dir pol
+static ssize_t ws_dir_pol_show(struct device *dev, 
+                               struct device_attribute *attr, char *buf)
+{
+        int ws_dir_pol;
+        struct am335x_ctrl *ctrl = pol_dev_to_ctrl(dev);
+
+        ws_dir_pol = am335x_shadow_get_lidd_pols(&ctrl->regs).ws_dir_pol;
+        return sprintf(buf, "%d\n", ws_dir_pol);
+}
+
+static ssize_t ws_dir_pol_store(struct device *dev, 
+                                struct device_attribute *attr,
+                                const char *buf, size_t count)
+{
+        int ret, ws_dir_pol;
+        struct am335x_ctrl *ctrl = pol_dev_to_ctrl(dev);
+
+        ret = kstrtoint(buf, 10, &ws_dir_pol);
+        if(ret < 0) 
+                return ret;
+
+        am335x_shadow_set_lidd_ctrl_bit(&ctrl->regs, AM335X_WS_DIR_POL_OFFS, 
+                                        ws_dir_pol);
+        am335x_shadow_flush(&ctrl->regs);
+        return count;
+}
+
+static DEVICE_ATTR_RW(ws_dir_pol);
+
+// rs_en pol
+static ssize_t rs_en_pol_show(struct device *dev, 
+                              struct device_attribute *attr, char *buf)
+{
+        int rs_en_pol;
+        struct am335x_ctrl *ctrl = pol_dev_to_ctrl(dev);
+
+        rs_en_pol = am335x_shadow_get_lidd_pols(&ctrl->regs).rs_en_pol;
+        return sprintf(buf, "%d\n", rs_en_pol);
+}
+
+static ssize_t rs_en_pol_store(struct device *dev, 
+                               struct device_attribute *attr,
+                               const char *buf, size_t count)
+{
+        int ret, rs_en_pol;
+        struct am335x_ctrl *ctrl = pol_dev_to_ctrl(dev);
+
+        ret = kstrtoint(buf, 10, &rs_en_pol);
+        if(ret < 0) 
+                return ret;
+
+        am335x_shadow_set_lidd_ctrl_bit(&ctrl->regs, AM335X_RS_EN_POL_OFFS, 
+                                        rs_en_pol);
+        am335x_shadow_flush(&ctrl->regs);
+        return count;
+}
+
+static DEVICE_ATTR_RW(rs_en_pol);
+
+// ale pol
+static ssize_t ale_pol_show(struct device *dev, 
+                            struct device_attribute *attr, char *buf)
+{
+        int ale_pol;
+        struct am335x_ctrl *ctrl = pol_dev_to_ctrl(dev);
+
+        ale_pol = am335x_shadow_get_lidd_pols(&ctrl->regs).ale_pol;
+        return sprintf(buf, "%d\n", ale_pol);
+}
+
+static ssize_t ale_pol_store(struct device *dev, 
+                             struct device_attribute *attr,
+                             const char *buf, size_t count)
+{
+        int ret, ale_pol;
+        struct am335x_ctrl *ctrl = pol_dev_to_ctrl(dev);
 
         ret = kstrtoint(buf, 10, &ale_pol);
         if(ret < 0) 
                 return ret;
 
-        am335x_set_ale_pol(ctrl->reg_base_addr, ale_pol);
+        am335x_shadow_set_lidd_ctrl_bit(&ctrl->regs, AM335X_ALEPOL_OFFS, 
+                                        ale_pol);
+        am335x_shadow_flush(&ctrl->regs);
         return count;
 }
 
@@ -499,11 +1182,12 @@ static void polarities_dev_release(struct device *dev)
         memset(dev, 0, sizeof(*dev));
 }
 
-static int am335x_polarities_sysfs_register(struct am335x_ctrl *ctrl, struct class *c)
+static int am335x_polarities_sysfs_register(struct am335x_ctrl *ctrl, 
+                                           struct device *parent)
 {
         int ret;
 
-        ctrl->pol_dev.class = c;
+        ctrl->pol_dev.parent = parent;
         ctrl->pol_dev.groups = am335x_polarities_groups;
         ctrl->pol_dev.release = polarities_dev_release;
         ret = dev_set_name(&ctrl->pol_dev, POLARITY_DEVICE_NAME);
@@ -527,6 +1211,7 @@ static void am335x_polarities_sysfs_unregister(struct am335x_ctrl *ctrl)
 
 static const unsigned int init_hw_clk_freq = 200000000;
 static const int init_clk_div = 1;
+static const u32 init_img_buf_size = SZ_2M;
 
 static struct am335x_lidd_timings init_timings = {
         .w_setup = 0,
@@ -538,6 +1223,17 @@ static struct am335x_lidd_timings init_timings = {
         .ta = 2
 };
 
+// the pixel profile starts out as safe as the register profile
+static struct am335x_lidd_timings init_pixel_timings = {
+        .w_setup = 0,
+        .w_strobe = 10,
+        .w_hold = 1,
+        .r_setup = 7,
+        .r_strobe = 15,
+        .r_hold = 15,
+        .ta = 2
+};
+
 static struct am335x_lidd_sig_pol init_sig_pols = {
         .ale_pol = NO_INVERT,
         .rs_en_pol = NO_INVERT,
@@ -546,57 +1242,223 @@ static struct am335x_lidd_sig_pol init_sig_pols = {
         .cs1_e1_pol = NO_INVERT,
 };
 
-static inline int wait_hrdy_timeout(struct am335x_ctrl *ctrl) {
-        unsigned long end_jiffies = jiffies + msecs_to_jiffies(TIMEOUT_MSECS);
-        do {
-                if(gpiod_get_value(ctrl->hrdy_gpio))
-                        return 0;
-        } while(jiffies < end_jiffies);
-        return -ETIME;
+/*
+ * The HRDY IRQ is only enabled while somebody waits for HRDY, either inside 
+ * a transfer or through poll().
+ */
+static void hrdy_irq_get(struct am335x_ctrl *ctrl)
+{
+        unsigned long flags;
+
+        spin_lock_irqsave(&ctrl->hrdy_lock, flags);
+        if(!ctrl->hrdy_irq_users++)
+                enable_irq(ctrl->hrdy_irq);
+        spin_unlock_irqrestore(&ctrl->hrdy_lock, flags);
 }
 
-static inline int wait_dma_timeout(struct am335x_ctrl *ctrl) {
-        unsigned long end_jiffies = jiffies + msecs_to_jiffies(3000);
-        do {
-                if(am335x_get_lcddma_done_raw_irq(ctrl->reg_base_addr)) {
-                        return 0;
-                }
-        } while(jiffies < end_jiffies);
-        
-        return -ETIME;
+static void hrdy_irq_put(struct am335x_ctrl *ctrl)
+{
+        unsigned long flags;
+
+        spin_lock_irqsave(&ctrl->hrdy_lock, flags);
+        if(!--ctrl->hrdy_irq_users)
+                disable_irq_nosync(ctrl->hrdy_irq);
+        spin_unlock_irqrestore(&ctrl->hrdy_lock, flags);
 }
 
-static int init(struct controller *ctrl, struct platform_device *pdev, 
-                struct class *c)
+static irqreturn_t hrdy_irq_handler(int irq, void *arg)
 {
-        int ret;
-        struct am335x_ctrl *am_ctrl;
+        struct am335x_ctrl *ctrl = arg;
 
-        am_ctrl = to_am335x_ctrl(ctrl);
+        if(test_and_clear_bit(0, &ctrl->hrdy_poll_armed))
+                hrdy_irq_put(ctrl);
 
-        // get resource
-        am_ctrl->hw_res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
-        if(!am_ctrl->hw_res) {
-                ret = -ENXIO;
-                goto get_pdev_res_fail;
+        wake_up(&ctrl->hrdy_wq);
+        return IRQ_HANDLED;
+}
+
+/*
+ * Keeps an average of the recent HRDY wait times. As long as the average fits
+ * into the spin window the whole window is spun. Beyond that the window 
+ * shrinks with the average, so long busy periods go to sleep right away.
+ */
+static void hrdy_update_spin(struct am335x_ctrl *ctrl, u64 waited_ns)
+{
+        unsigned int avg = READ_ONCE(ctrl->hrdy_wait_avg_ns);
+        unsigned int max = READ_ONCE(ctrl->hrdy_spin_max_ns);
+        unsigned int waited = min_t(u64, waited_ns, U32_MAX);
+
+        avg = avg - (avg >> HRDY_WAIT_AVG_SHIFT) + 
+              (waited >> HRDY_WAIT_AVG_SHIFT);
+        WRITE_ONCE(ctrl->hrdy_wait_avg_ns, avg);
+
+        // a window of 0 disables spinning
+        if(avg <= max || !max)
+                WRITE_ONCE(ctrl->hrdy_spin_ns, max);
+        else
+                WRITE_ONCE(ctrl->hrdy_spin_ns, 
+                           max_t(unsigned int, HRDY_SPIN_MIN_NS,
+                                 div_u64((u64)max * max, avg)));
+}
+
+static int wait_hrdy_slow(struct am335x_ctrl *ctrl, enum hrdy_phase phase)
+{
+        long ret;
+        u64 start, spin_end, waited;
+        unsigned int timeout = ctrl->ctrl.xfer_hrdy_timeout;
+
+        if(!timeout)
+                timeout = TIMEOUT_MSECS;
+
+        start = ktime_get_ns();
+        spin_end = start + READ_ONCE(ctrl->hrdy_spin_ns);
+        while(ktime_get_ns() < spin_end) {
+                if(gpiod_get_value(ctrl->hrdy_gpio))
+                        goto ready;
         }
 
-        if(!devm_request_mem_region(&pdev->dev, am_ctrl->hw_res->start, 
-                                    resource_size(am_ctrl->hw_res), 
-                                    dev_name(&pdev->dev))) {
-                ret = -EBUSY;
-                goto req_hw_mem_fail;
+        hrdy_irq_get(ctrl);
+        ret = wait_event_timeout(ctrl->hrdy_wq, 
+                                 gpiod_get_value(ctrl->hrdy_gpio),
+                                 msecs_to_jiffies(timeout));
+        hrdy_irq_put(ctrl);
+        if(!ret) {
+                ctrl->stats.hrdy_timeouts++;
+                trace_pl_par_hrdy_wait(phase, ktime_get_ns() - start, -ETIME);
+                trace_pl_par_timeout("hrdy");
+                return -ETIME;
         }
 
-        am_ctrl->reg_base_addr = devm_ioremap_nocache(&pdev->dev, 
-                                              am_ctrl->hw_res->start, 
-                                              resource_size(am_ctrl->hw_res));
-        if(!am_ctrl->reg_base_addr) {
-                ret = -ENOMEM;
-                goto remap_res_fail;
+ready:
+        waited = ktime_get_ns() - start;
+        trace_pl_par_hrdy_wait(phase, waited, 0);
+        stats_hrdy(ctrl, phase, waited);
+        hrdy_update_spin(ctrl, waited);
+        return 0;
+}
+
+static inline int wait_hrdy_timeout(struct am335x_ctrl *ctrl, 
+                                    enum hrdy_phase phase)
+{
+        if(gpiod_get_value(ctrl->hrdy_gpio)) {
+                stats_hrdy(ctrl, phase, 0);
+                hrdy_update_spin(ctrl, 0);
+                return 0;
         }
+        return wait_hrdy_slow(ctrl, phase);
+}
 
-        // get clk
+static void lidd_dma_en(struct am335x_ctrl *ctrl, unsigned enable)
+{
+        am335x_shadow_set_lidd_dma_en(&ctrl->regs, enable);
+        am335x_shadow_flush(&ctrl->regs);
+}
+
+/*
+ * In dual frame mode the LCDDMA continues with the other frame buffer right 
+ * away, so this is only allowed while the next frame buffer holds a queued 
+ * chunk. Otherwise the engine runs in one frame mode and stops after the 
+ * chunk in flight. Has to be called with the stream lock held.
+ */
+static void lcdc_stream_set_mode(struct am335x_ctrl *ctrl)
+{
+        struct am335x_dma_stream *s = &ctrl->stream;
+
+        am335x_shadow_set_lcddma_frame_mode(&ctrl->regs, 
+                                            (s->queued > s->done + 1) ? 
+                                            DUAL_FRAME : ONE_FRAME);
+        am335x_shadow_flush(&ctrl->regs);
+}
+
+/*
+ * Handles the LCDDMA interrupts during a stream. Every finished frame buffer
+ * switches the mode for the chunk that has just started, the engine signals
+ * DONE when it has stopped after a chunk in one frame mode. If the interrupt 
+ * comes too late, the engine has already wrapped onto a stale buffer.
+ */
+static void lcdc_stream_irq(struct am335x_ctrl *ctrl, unsigned status)
+{
+        struct am335x_dma_stream *s = &ctrl->stream;
+
+        spin_lock(&s->lock);
+        if(status & AM335X_LCDDMA_IRQ_EOF0)
+                s->done++;
+        if(status & AM335X_LCDDMA_IRQ_EOF1)
+                s->done++;
+
+        if(status & AM335X_LCDDMA_IRQ_DONE) {
+                lidd_dma_en(ctrl, 0);
+                s->running = 0;
+        } else if(s->running && s->queued <= s->done) {
+                lidd_dma_en(ctrl, 0);
+                s->running = 0;
+                s->error = -EIO;
+        } else if(s->running) {
+                lcdc_stream_set_mode(ctrl);
+        }
+        spin_unlock(&s->lock);
+        wake_up(&s->wq);
+}
+
+static irqreturn_t lcdc_irq_handler(int irq, void *arg)
+{
+        struct am335x_ctrl *ctrl = arg;
+        unsigned status;
+
+        status = am335x_get_lcdc_irqstatus(ctrl->reg_base_addr);
+        if(!status)
+                return IRQ_NONE;
+
+        am335x_clear_lcdc_irqstatus(ctrl->reg_base_addr, status);
+
+        if(ctrl->stream.active) {
+                lcdc_stream_irq(ctrl, status);
+        } else if(status & (AM335X_LCDDMA_IRQ_DONE | AM335X_LCDDMA_IRQ_EOF0)) {
+                complete(&ctrl->dma_done);
+        }
+
+        am335x_set_lcdc_eoi(ctrl->reg_base_addr);
+        return IRQ_HANDLED;
+}
+
+static int init(struct controller *ctrl, struct platform_device *pdev, 
+                struct device *parent)
+{
+        int ret;
+        u32 img_buf_size;
+        struct am335x_ctrl *am_ctrl;
+
+        am_ctrl = to_am335x_ctrl(ctrl);
+        am_ctrl->dev = &pdev->dev;
+        init_completion(&am_ctrl->dma_done);
+
+        ret = dma_set_mask_and_coherent(&pdev->dev, DMA_BIT_MASK(32));
+        if(ret)
+                goto get_pdev_res_fail;
+
+        // get resource
+        am_ctrl->hw_res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+        if(!am_ctrl->hw_res) {
+                ret = -ENXIO;
+                goto get_pdev_res_fail;
+        }
+
+        if(!devm_request_mem_region(&pdev->dev, am_ctrl->hw_res->start, 
+                                    resource_size(am_ctrl->hw_res), 
+                                    dev_name(&pdev->dev))) {
+                ret = -EBUSY;
+                goto req_hw_mem_fail;
+        }
+
+        am_ctrl->reg_base_addr = devm_ioremap_nocache(&pdev->dev, 
+                                              am_ctrl->hw_res->start, 
+                                              resource_size(am_ctrl->hw_res));
+        if(!am_ctrl->reg_base_addr) {
+                ret = -ENOMEM;
+                goto remap_res_fail;
+        }
+
+        // get clk
         am_ctrl->hw_clk = devm_clk_get(&pdev->dev, AM335X_TCON_CLK_IDENTIFIER);
         if(IS_ERR(am_ctrl->hw_clk)) {
                 ret = PTR_ERR(am_ctrl->hw_clk);
@@ -624,49 +1486,135 @@ static int init(struct controller *ctrl, struct platform_device *pdev,
                 goto hrdy_gpio_req_fail;
         }
 
-        // add object to sysfs
-        ret = am335x_timings_sysfs_register(am_ctrl, c);
+        // request HRDY IRQ, it is only enabled while waiting for HRDY
+        init_waitqueue_head(&am_ctrl->hrdy_wq);
+        spin_lock_init(&am_ctrl->hrdy_lock);
+        am_ctrl->hrdy_irq_users = 0;
+        am_ctrl->hrdy_poll_armed = 0;
+        am_ctrl->hrdy_spin_max_ns = HRDY_SPIN_DEFAULT_NS;
+        am_ctrl->hrdy_spin_ns = HRDY_SPIN_DEFAULT_NS;
+        am_ctrl->hrdy_wait_avg_ns = 0;
+
+        am_ctrl->hrdy_irq = gpiod_to_irq(am_ctrl->hrdy_gpio);
+        if(am_ctrl->hrdy_irq < 0) {
+                ret = am_ctrl->hrdy_irq;
+                goto hrdy_irq_req_fail;
+        }
+
+        irq_set_status_flags(am_ctrl->hrdy_irq, IRQ_NOAUTOEN);
+        ret = devm_request_irq(&pdev->dev, am_ctrl->hrdy_irq, hrdy_irq_handler,
+                               gpiod_is_active_low(am_ctrl->hrdy_gpio) ? 
+                               IRQF_TRIGGER_FALLING : IRQF_TRIGGER_RISING,
+                               HRDY_GPIO_ID, am_ctrl);
         if(ret)
-                goto timings_add_fail;
+                goto hrdy_irq_req_fail;
+
+        // request LCDC IRQ
+        am_ctrl->irq_num = platform_get_irq(pdev, 0);
+        if(am_ctrl->irq_num < 0) {
+                ret = am_ctrl->irq_num;
+                goto irq_req_fail;
+        }
 
-        ret = am335x_polarities_sysfs_register(am_ctrl, c);
+        ret = devm_request_irq(&pdev->dev, am_ctrl->irq_num, lcdc_irq_handler,
+                               0, dev_name(&pdev->dev), am_ctrl);
         if(ret)
-                goto polarities_add_fail;
+                goto irq_req_fail;
+
+        // allocate mmap'able image buffer
+        if(of_property_read_u32(pdev->dev.of_node, AM335X_IMG_BUF_SIZE_PROP,
+                                &img_buf_size))
+                img_buf_size = init_img_buf_size;
+
+#       ifdef BURST_DMA
+
+        // allocate ping-pong buffers for streamed LCDDMA transfers
+        am_ctrl->dma_chunk[0] = dma_alloc_coherent(&pdev->dev, 
+                                                   2 * AM335X_DMA_CHUNK_SIZE,
+                                                   &am_ctrl->dma_chunk_dma[0],
+                                                   GFP_KERNEL);
+        if(!am_ctrl->dma_chunk[0]) {
+                ret = -ENOMEM;
+                goto dma_chunk_alloc_fail;
+        }
+        am_ctrl->dma_chunk[1] = am_ctrl->dma_chunk[0] + AM335X_DMA_CHUNK_SIZE;
+        am_ctrl->dma_chunk_dma[1] = am_ctrl->dma_chunk_dma[0] + 
+                                    AM335X_DMA_CHUNK_SIZE;
+
+#       endif
+        init_waitqueue_head(&am_ctrl->stream.wq);
+        spin_lock_init(&am_ctrl->stream.lock);
+
+        if(img_buf_size) {
+                img_buf_size = PAGE_ALIGN(img_buf_size);
+                am_ctrl->img_buf = dma_alloc_coherent(&pdev->dev, img_buf_size,
+                                                      &am_ctrl->img_buf_dma,
+                                                      GFP_KERNEL);
+                if(!am_ctrl->img_buf) {
+                        ret = -ENOMEM;
+                        goto img_buf_alloc_fail;
+                }
+                ctrl->buf = am_ctrl->img_buf;
+                ctrl->buf_size = img_buf_size;
+        }
 
         // enable clocks        
         am335x_lcdc_set_core_clk_en(am_ctrl->reg_base_addr, 1);
         am335x_lcdc_set_lidd_clk_en(am_ctrl->reg_base_addr, 1);
         am335x_lcdc_set_dma_clk_en(am_ctrl->reg_base_addr, 1);
 
-        // set clock divisor
-        am335x_lcdc_set_clkdiv(am_ctrl->reg_base_addr, init_clk_div);
-
         // sys config
         am335x_lcdc_set_standby_mode(am_ctrl->reg_base_addr, NO_STANDBY);
         am335x_lcdc_set_idle_mode(am_ctrl->reg_base_addr, NO_IDLE);
 
+        // the configuration registers are set up in memory and written once
+        am335x_shadow_init(&am_ctrl->regs, am_ctrl->reg_base_addr);
+
+        // set clock divisor
+        am335x_shadow_set_clkdiv(&am_ctrl->regs, init_clk_div);
+
         // set signal polarities
-        am335x_set_lidd_pols(am_ctrl->reg_base_addr, &init_sig_pols);
+        am335x_shadow_set_lidd_pols(&am_ctrl->regs, &init_sig_pols);
 
-        am335x_lcdc_set_ctrl_mode(am_ctrl->reg_base_addr, LIDD_MODE);
+        am335x_shadow_set_ctrl_mode(&am_ctrl->regs, LIDD_MODE);
         
         // set lidd mode
-        am335x_set_lidd_mode(am_ctrl->reg_base_addr, ASYNC_MPU80);
+        am335x_shadow_set_lidd_mode(&am_ctrl->regs, ASYNC_MPU80);
         
         // set timings
-        am335x_set_lidd_timings(am_ctrl->reg_base_addr, LIDD_CS0, &init_timings);
-        am335x_set_lidd_timings(am_ctrl->reg_base_addr, LIDD_CS1, &init_timings);
+        am335x_shadow_set_lidd_timings(&am_ctrl->regs, LIDD_CS0, &init_timings);
+        am335x_shadow_set_lidd_timings(&am_ctrl->regs, LIDD_CS1, 
+                                       &init_pixel_timings);
 
         // set lcddma config
-        am335x_set_lidd_dma_en(am_ctrl->reg_base_addr, 0);
-        am335x_set_dma_cs0_cs1(am_ctrl->reg_base_addr, LIDD_CS0);
-        am335x_set_lcddma_master_prio(am_ctrl->reg_base_addr, HIGH_PRIO);
-        am335x_set_lcddma_fifo_threshold(am_ctrl->reg_base_addr, FIFO_TH_8);
-        am335x_set_lcddma_burst_size(am_ctrl->reg_base_addr, BURST_SIZE_1);
-        am335x_set_lcddma_frame_mode(am_ctrl->reg_base_addr, ONE_FRAME);
+        am335x_shadow_set_lidd_dma_en(&am_ctrl->regs, 0);
+        am335x_shadow_set_dma_cs0_cs1(&am_ctrl->regs, LIDD_CS0);
+        am_ctrl->cs = LIDD_CS0;
+        am335x_shadow_set_lcddma_master_prio(&am_ctrl->regs, HIGH_PRIO);
+        am335x_shadow_set_lcddma_fifo_threshold(&am_ctrl->regs, FIFO_TH_8);
+        am335x_shadow_set_lcddma_burst_size(&am_ctrl->regs, BURST_SIZE_1);
+        am335x_shadow_set_lcddma_frame_mode(&am_ctrl->regs, ONE_FRAME);
+
+        am335x_shadow_flush(&am_ctrl->regs);
+
+        // timings given in nanoseconds override the cycle counts
+        timings_ns_init(am_ctrl, pdev->dev.of_node);
+
+        // add object to sysfs
+        ret = am335x_timings_sysfs_register(am_ctrl, parent);
+        if(ret)
+                goto timings_add_fail;
+
+        ret = am335x_polarities_sysfs_register(am_ctrl, parent);
+        if(ret)
+                goto polarities_add_fail;
 
         // enable LCDDMA IRQ's
+        am335x_clear_lcdc_irqstatus(am_ctrl->reg_base_addr, 
+                                    am335x_get_lcdc_irqstatus(
+                                                am_ctrl->reg_base_addr));
         am335x_set_lcddma_eof0_en_set(am_ctrl->reg_base_addr);
+        am335x_set_lcddma_eof1_en_set(am_ctrl->reg_base_addr);
         am335x_set_lcddma_done_en_set(am_ctrl->reg_base_addr);
 
         return 0;
@@ -675,6 +1623,20 @@ static int init(struct controller *ctrl, struct platform_device *pdev,
 polarities_add_fail:
         am335x_timings_sysfs_unregister(am_ctrl);
 timings_add_fail:
+        clk_notifier_unregister(am_ctrl->hw_clk, &am_ctrl->clk_nb);
+        if(am_ctrl->img_buf)
+                dma_free_coherent(&pdev->dev, ctrl->buf_size, am_ctrl->img_buf,
+                                  am_ctrl->img_buf_dma);
+img_buf_alloc_fail:
+        if(am_ctrl->dma_chunk[0])
+                dma_free_coherent(&pdev->dev, 2 * AM335X_DMA_CHUNK_SIZE, 
+                                  am_ctrl->dma_chunk[0], 
+                                  am_ctrl->dma_chunk_dma[0]);
+dma_chunk_alloc_fail:
+        devm_free_irq(&pdev->dev, am_ctrl->irq_num, am_ctrl);
+irq_req_fail:
+        devm_free_irq(&pdev->dev, am_ctrl->hrdy_irq, am_ctrl);
+hrdy_irq_req_fail:
         devm_gpiod_put(&pdev->dev, am_ctrl->hrdy_gpio);
 hrdy_gpio_req_fail:
 clk_en_fail:
@@ -688,35 +1650,71 @@ remap_res_fail:
                                 resource_size(am_ctrl->hw_res));
 req_hw_mem_fail:
 get_pdev_res_fail:
+        kfree(am_ctrl);
         return ret;
 }
 
 static void destroy(struct controller *ctrl, struct platform_device *pdev,
-                    struct class *c)
+                    struct device *parent)
 {
         struct am335x_ctrl *am_ctrl = to_am335x_ctrl(ctrl);
+        am335x_set_lcddma_eof0_en_clr(am_ctrl->reg_base_addr);
+        am335x_set_lcddma_eof1_en_clr(am_ctrl->reg_base_addr);
+        am335x_set_lcddma_done_en_clr(am_ctrl->reg_base_addr);
+        if(am_ctrl->img_buf)
+                dma_free_coherent(&pdev->dev, ctrl->buf_size, am_ctrl->img_buf,
+                                  am_ctrl->img_buf_dma);
+        if(am_ctrl->dma_chunk[0])
+                dma_free_coherent(&pdev->dev, 2 * AM335X_DMA_CHUNK_SIZE, 
+                                  am_ctrl->dma_chunk[0], 
+                                  am_ctrl->dma_chunk_dma[0]);
+        devm_free_irq(&pdev->dev, am_ctrl->irq_num, am_ctrl);
+        devm_free_irq(&pdev->dev, am_ctrl->hrdy_irq, am_ctrl);
         devm_gpiod_put(&pdev->dev, am_ctrl->hrdy_gpio);
+        clk_notifier_unregister(am_ctrl->hw_clk, &am_ctrl->clk_nb);
         devm_clk_put(&pdev->dev, am_ctrl->hw_clk);
         devm_iounmap(&pdev->dev, am_ctrl->reg_base_addr);
         devm_release_mem_region(&pdev->dev, am_ctrl->hw_res->start,
                                 resource_size(am_ctrl->hw_res));
         am335x_timings_sysfs_unregister(am_ctrl);
         am335x_polarities_sysfs_unregister(am_ctrl);
-        am335x_set_lcddma_eof0_en_clr(am_ctrl->reg_base_addr);
         kfree(am_ctrl);
 }
 
 static void write_addr(struct am335x_ctrl *ctrl, short addr)
 {
-        am335x_set_lidd_addr(ctrl->reg_base_addr, LIDD_CS0, addr);
+        trace_pl_par_addr(addr);
+        am335x_set_lidd_addr(ctrl->reg_base_addr, ctrl->cs, addr);
 }
 
-static int write_data(struct am335x_ctrl *ctrl, const short *data, size_t len)
+static void write_data_pio_no_hrdy(struct am335x_ctrl *ctrl, const short *data,
+                                   size_t len)
 {
-        int ret, i;
+        int i;
         for(i = 0; i < len; i++) {
-                am335x_set_lidd_data(ctrl->reg_base_addr, LIDD_CS0, data[i]);
-                ret = wait_hrdy_timeout(ctrl);
+                am335x_set_lidd_data(ctrl->reg_base_addr, ctrl->cs, data[i]);
+        }
+        ctrl->stats.pio_words += len;
+}
+
+/*
+ * Writes the data in groups of hrdy_interval words and checks HRDY after
+ * each group. Devices with an input FIFO only need the check once per FIFO
+ * depth, an interval of 1 checks every word. A transaction can override the
+ * interval with xfer_hrdy_interval.
+ */
+static int write_data(struct am335x_ctrl *ctrl, const short *data, size_t len)
+{
+        size_t i, n, interval = ctrl->ctrl.xfer_hrdy_interval;
+        int ret;
+
+        if(!interval)
+                interval = max(READ_ONCE(ctrl->ctrl.hrdy_interval), 1u);
+
+        for(i = 0; i < len; i += n) {
+                n = min(len - i, interval);
+                write_data_pio_no_hrdy(ctrl, &data[i], n);
+                ret = wait_hrdy_timeout(ctrl, HRDY_WORD);
                 if(ret) {
                         pr_warn("%s: Write I8080 timeout!\n", THIS_MODULE->name);
                         return -EIO;
@@ -726,62 +1724,449 @@ static int write_data(struct am335x_ctrl *ctrl, const short *data, size_t len)
         return 0;
 }
 
-static int write_data_no_hrdy(struct am335x_ctrl *ctrl, const short *data, size_t len)
+#ifdef BURST_DMA
+
+/*
+ * Transfers len words starting at the 32-bit aligned bus address addr via
+ * FB0 and sleeps until the LCDC signals the end of the frame.
+ */
+static int write_data_dma(struct am335x_ctrl *ctrl, dma_addr_t addr, size_t len)
 {
-#       ifdef BURST_DMA
+        long ret;
+
+        reinit_completion(&ctrl->dma_done);
+        am335x_clear_lcdc_irqstatus(ctrl->reg_base_addr, 
+                                    AM335X_LCDDMA_IRQ_DONE | 
+                                    AM335X_LCDDMA_IRQ_EOF0);
+
+        am335x_set_lcddma_fb0_base_addr(ctrl->reg_base_addr, addr);
+        am335x_set_lcddma_fb0_ceil_addr(ctrl->reg_base_addr, 
+                                        addr + len * sizeof(short) - 1);
+        trace_pl_par_dma_start(len, 1);
+        lidd_dma_en(ctrl, 1);
+
+        ret = wait_for_completion_timeout(&ctrl->dma_done, 
+                                          msecs_to_jiffies(DMA_TIMEOUT_MSECS));
+        lidd_dma_en(ctrl, 0);
+
+        if(!ret) {
+                trace_pl_par_timeout("dma");
+                trace_pl_par_dma_done(len, -ETIME);
+                pr_warn("%s: LCDDMA timeout!\n", THIS_MODULE->name);
+                return -ETIME;
+        }
+        trace_pl_par_dma_done(len, 0);
+        ctrl->stats.dma_words += len;
+        return 0;
+}
 
+/*
+ * The LCDDMA fetches whole 32-bit words. An unaligned first word or an odd 
+ * last word is therefore written through the LIDD data register.
+ */
+static int write_data_dma_mapped(struct am335x_ctrl *ctrl, const short *data,
+                                 dma_addr_t addr, size_t len)
+{
         int ret;
-        am335x_set_lcddma_fb0_base_addr(ctrl->reg_base_addr, data);
-        am335x_set_lcddma_fb0_ceil_addr(ctrl->reg_base_addr, &data[len - 1]);
-        am335x_set_lidd_dma_en(ctrl->reg_base_addr, 1);
-        ret = wait_dma_timeout(ctrl);
-        am335x_set_lidd_dma_en(ctrl->reg_base_addr, 0);
+
+        if(addr & 3) {
+                write_data_pio_no_hrdy(ctrl, data, 1);
+                data++;
+                addr += sizeof(*data);
+                len--;
+        }
+
+        if(len > 1) {
+                ret = write_data_dma(ctrl, addr, len & ~1ul);
+                if(ret)
+                        return ret;
+        }
+
+        if(len & 1)
+                write_data_pio_no_hrdy(ctrl, &data[len - 1], 1);
+
+        return 0;
+}
+
+static int write_data_dma_single(struct am335x_ctrl *ctrl, const short *data,
+                                 size_t len)
+{
+        int ret;
+        dma_addr_t addr;
+        size_t size = len * sizeof(*data);
+
+        addr = dma_map_single(ctrl->dev, (void *)data, size, DMA_TO_DEVICE);
+        if(dma_mapping_error(ctrl->dev, addr))
+                return -ENOMEM;
+
+        ret = write_data_dma_mapped(ctrl, data, addr, len);
+
+        dma_unmap_single(ctrl->dev, addr, size, DMA_TO_DEVICE);
         return ret;
+}
+
+/*
+ * Points the frame buffer of chunk i at its ping-pong buffer.
+ */
+static void write_data_dma_stream_map(struct am335x_ctrl *ctrl, unsigned int i,
+                                      size_t len)
+{
+        size_t n = min_t(size_t, DMA_CHUNK_WORDS, len - i * DMA_CHUNK_WORDS);
+        dma_addr_t base = ctrl->dma_chunk_dma[i & 1];
+        dma_addr_t ceil = base + n * sizeof(short) - 1;
+
+        if(((i - ctrl->stream.first) & 1) == FB0) {
+                am335x_set_lcddma_fb0_base_addr(ctrl->reg_base_addr, base);
+                am335x_set_lcddma_fb0_ceil_addr(ctrl->reg_base_addr, ceil);
+        } else {
+                am335x_set_lcddma_fb1_base_addr(ctrl->reg_base_addr, base);
+                am335x_set_lcddma_fb1_ceil_addr(ctrl->reg_base_addr, ceil);
+        }
+}
 
-#       else
+/*
+ * Copies chunk i of a stream into its ping-pong buffer and maps it.
+ */
+static void write_data_dma_stream_fill(struct am335x_ctrl *ctrl, unsigned int i,
+                                       const short *data, size_t len)
+{
+        size_t offs = i * DMA_CHUNK_WORDS;
+        size_t n = min_t(size_t, DMA_CHUNK_WORDS, len - offs);
 
-        int i;
-        for(i = 0; i < len; i++) {
-                am335x_set_lidd_data(ctrl->reg_base_addr, LIDD_CS0, data[i]);
+        memcpy(ctrl->dma_chunk[i & 1], &data[offs], n * sizeof(*data));
+        wmb();
+        write_data_dma_stream_map(ctrl, i, len);
+}
+
+/*
+ * Streams len words through the two ping-pong buffers. While the LCDDMA 
+ * drains one frame buffer the other one is refilled and the engine runs in 
+ * dual frame mode, so it continues without a gap. If a refill is late, the 
+ * engine stops after the chunk in flight and is restarted from the next one,
+ * it never sends a buffer twice. len has to span more than one chunk.
+ */
+static int write_data_dma_stream(struct am335x_ctrl *ctrl, const short *data,
+                                 size_t len)
+{
+        struct am335x_dma_stream *s = &ctrl->stream;
+        size_t dma_len = len & ~1ul;
+        unsigned long timeout = msecs_to_jiffies(DMA_TIMEOUT_MSECS);
+        unsigned long flags;
+        unsigned int i, j;
+        int ret = 0;
+
+        s->total = DIV_ROUND_UP(dma_len, DMA_CHUNK_WORDS);
+        s->first = 0;
+        s->queued = 0;
+        s->done = 0;
+        s->running = 0;
+        s->error = 0;
+
+        am335x_clear_lcdc_irqstatus(ctrl->reg_base_addr, 
+                                    AM335X_LCDDMA_IRQ_DONE | 
+                                    AM335X_LCDDMA_IRQ_EOF0 |
+                                    AM335X_LCDDMA_IRQ_EOF1);
+        WRITE_ONCE(s->active, 1);
+        trace_pl_par_dma_start(dma_len, s->total);
+
+        for(i = 0; i < s->total; i++) {
+                // wait until the ping-pong buffer of chunk i has been drained
+                if(!wait_event_timeout(s->wq, i < READ_ONCE(s->done) + 2 ||
+                                       READ_ONCE(s->error), timeout)) {
+                        ret = -ETIME;
+                        break;
+                }
+                if(READ_ONCE(s->error))
+                        break;
+
+                write_data_dma_stream_fill(ctrl, i, data, dma_len);
+
+                spin_lock_irqsave(&s->lock, flags);
+                s->queued = i + 1;
+                if(s->running || s->error) {
+                        if(s->running)
+                                lcdc_stream_set_mode(ctrl);
+                        spin_unlock_irqrestore(&s->lock, flags);
+                        continue;
+                }
+
+                // the engine has stopped, restart it from the first unsent
+                // chunk on FB0
+                s->first = s->done;
+                for(j = s->first; j <= i; j++)
+                        write_data_dma_stream_map(ctrl, j, dma_len);
+                s->running = 1;
+                lcdc_stream_set_mode(ctrl);
+                lidd_dma_en(ctrl, 1);
+                spin_unlock_irqrestore(&s->lock, flags);
         }
 
+        if(!ret && !wait_event_timeout(s->wq, READ_ONCE(s->done) == s->total || 
+                                       READ_ONCE(s->error), timeout))
+                ret = -ETIME;
+
+        spin_lock_irqsave(&s->lock, flags);
+        lidd_dma_en(ctrl, 0);
+        s->running = 0;
+        spin_unlock_irqrestore(&s->lock, flags);
+        WRITE_ONCE(s->active, 0);
+        am335x_shadow_set_lcddma_frame_mode(&ctrl->regs, ONE_FRAME);
+        am335x_shadow_flush(&ctrl->regs);
+
+        if(ret == -ETIME)
+                trace_pl_par_timeout("dma_stream");
+        if(!ret)
+                ret = s->error;
+        trace_pl_par_dma_done(dma_len, ret);
+        if(ret) {
+                pr_warn("%s: LCDDMA stream failed (%d)!\n", 
+                        THIS_MODULE->name, ret);
+                return ret;
+        }
+        ctrl->stats.dma_words += dma_len;
+
+        if(len & 1)
+                write_data_pio_no_hrdy(ctrl, &data[len - 1], 1);
+
         return 0;
+}
 
-#       endif
+/*
+ * Writes the word at byte offset offs of a scatter list segment through the 
+ * LIDD data register.
+ */
+static void write_sg_word_pio(struct am335x_ctrl *ctrl, struct scatterlist *sg,
+                              size_t offs)
+{
+        struct page *page;
+        void *vaddr;
+
+        offs += sg->offset;
+        page = nth_page(sg_page(sg), offs >> PAGE_SHIFT);
+        vaddr = kmap_atomic(page);
+        write_data_pio_no_hrdy(ctrl, vaddr + offset_in_page(offs), 1);
+        kunmap_atomic(vaddr);
 }
 
-static ssize_t read(struct controller *ctrl, unsigned short *buf, size_t len)
+/*
+ * Transfers a mapped scatter list segment by segment. Without an IOMMU every
+ * DMA segment matches its CPU segment, which is used for the unaligned head 
+ * and the odd tail word.
+ */
+static int write_sg_dma(struct am335x_ctrl *ctrl, struct sg_table *sgt, 
+                        size_t len)
 {
+        struct scatterlist *sg;
+        dma_addr_t addr;
+        size_t n, offs;
         int i, ret;
-        struct am335x_ctrl *c = to_am335x_ctrl(ctrl);
+
+        for_each_sg(sgt->sgl, sg, sgt->orig_nents, i) {
+                addr = sg_dma_address(sg);
+                n = min_t(size_t, len, sg_dma_len(sg) / sizeof(short));
+                len -= n;
+                offs = 0;
+
+                if(addr & 3) {
+                        write_sg_word_pio(ctrl, sg, 0);
+                        addr += sizeof(short);
+                        offs = sizeof(short);
+                        n--;
+                }
+
+                if(n > 1) {
+                        ret = write_data_dma(ctrl, addr, n & ~1ul);
+                        if(ret)
+                                return ret;
+                }
+
+                if(n & 1)
+                        write_sg_word_pio(ctrl, sg, 
+                                          offs + (n - 1) * sizeof(short));
+
+                if(!len)
+                        break;
+        }
+
+        return 0;
+}
+
+#endif /* BURST_DMA */
+
+/*
+ * Writes len words from a scatter list through the LIDD data register. The 
+ * pages are mapped one at a time, hrdy selects the per-word HRDY handshake.
+ */
+static int write_sg_pio(struct am335x_ctrl *ctrl, struct sg_table *sgt,
+                        size_t len, int hrdy)
+{
+        struct sg_mapping_iter miter;
+        size_t n;
+        int ret = 0;
+
+        sg_miter_start(&miter, sgt->sgl, sgt->orig_nents, SG_MITER_FROM_SG);
+        while(len && sg_miter_next(&miter)) {
+                n = min_t(size_t, len, miter.length / sizeof(short));
+                if(hrdy) {
+                        ret = write_data(ctrl, miter.addr, n);
+                        if(ret)
+                                break;
+                } else {
+                        write_data_pio_no_hrdy(ctrl, miter.addr, n);
+                }
+                len -= n;
+        }
+        sg_miter_stop(&miter);
+
+        return ret;
+}
+
+static int write_sg_no_hrdy(struct am335x_ctrl *ctrl, struct sg_table *sgt,
+                            size_t len)
+{
+#       ifdef BURST_DMA
+        int nents, ret;
+
+        nents = dma_map_sg(ctrl->dev, sgt->sgl, sgt->orig_nents, 
+                           DMA_TO_DEVICE);
+        if(nents == sgt->orig_nents) {
+                ret = write_sg_dma(ctrl, sgt, len);
+                dma_unmap_sg(ctrl->dev, sgt->sgl, sgt->orig_nents, 
+                             DMA_TO_DEVICE);
+                return ret;
+        }
+
+        // merged segments can't be matched to their pages, fall back to PIO
+        if(nents)
+                dma_unmap_sg(ctrl->dev, sgt->sgl, sgt->orig_nents, 
+                             DMA_TO_DEVICE);
+#       endif
+
+        return write_sg_pio(ctrl, sgt, len, 0);
+}
+
+static int write_data_no_hrdy(struct am335x_ctrl *ctrl, const short *data, size_t len)
+{
+#       ifdef BURST_DMA
+
+        // transfers spanning more than one chunk are streamed
+        if(len > DMA_CHUNK_WORDS + 1)
+                return write_data_dma_stream(ctrl, data, len);
+
+        // short transfers are cheaper without the DMA setup
+        if(len >= DMA_MIN_WORDS)
+                return write_data_dma_single(ctrl, data, len);
+
+#       endif
+
+        write_data_pio_no_hrdy(ctrl, data, len);
+        return 0;
+}
+
+static int write_buf_no_hrdy(struct am335x_ctrl *ctrl, size_t offset, size_t len)
+{
+        const short *data = (const short *)ctrl->img_buf + offset;
+
+#       ifdef BURST_DMA
+
+        // the image buffer is coherent, no mapping needed
+        if(len >= DMA_MIN_WORDS)
+                return write_data_dma_mapped(ctrl, data, ctrl->img_buf_dma + 
+                                             offset * sizeof(*data), len);
+
+#       endif
+
+        write_data_pio_no_hrdy(ctrl, data, len);
+        return 0;
+}
+
+/*
+ * Reads len words in blocks of read_hrdy_interval words, HRDY is checked 
+ * before each block. The words of a block are read back to back with string
+ * reads of the data register. An interval of 0 reads all words without 
+ * checking HRDY.
+ */
+static ssize_t read_words(struct am335x_ctrl *c, unsigned short *buf, 
+                          size_t len)
+{
+        size_t i, n, interval = READ_ONCE(c->ctrl.read_hrdy_interval);
+        int ret;
+
+        for(i = 0; i < len; i += n) {
+                n = interval ? min(len - i, interval) : len;
+                if(interval) {
+                        ret = wait_hrdy_timeout(c, HRDY_WORD);
+                        if(ret) {
+                                pr_warn("%s: Read I8080 timeout!\n", 
+                                        THIS_MODULE->name);
+                                return -EIO;
+                        }
+                }
+                am335x_get_lidd_data_rep(c->reg_base_addr, c->cs, &buf[i], n);
+                c->stats.words_read += n;
+        }
+        return len;
+}
+
+static int read_dummy(struct am335x_ctrl *ctrl)
+{
+        int ret;
 
         /*
          * For whatever reason the parallel bus reads the first element twice.
          * To compensate this we do a dummy read operation.
          */
-        ret = wait_hrdy_timeout(c);
+        ret = wait_hrdy_timeout(ctrl, HRDY_PRE_DATA);
         if(ret) {
                 pr_warn("%s: Read I8080 timeout!\n", THIS_MODULE->name);
                 return -EIO;
         }
-        am335x_get_lidd_data(c->reg_base_addr, LIDD_CS0);
+        am335x_get_lidd_data(ctrl->reg_base_addr, ctrl->cs);
 
-        for(i = 0; i < len; i++) {
-                ret = wait_hrdy_timeout(c);
-                if(ret) {
-                        pr_warn("%s: Read I8080 timeout!\n", THIS_MODULE->name);
-                        return -EIO;
-                }
-                buf[i] = am335x_get_lidd_data(c->reg_base_addr, LIDD_CS0);
+        return 0;
+}
+
+static ssize_t do_read(struct am335x_ctrl *c, unsigned short *buf, 
+                       size_t len)
+{
+        int ret;
+
+        ret = read_dummy(c);
+        if(ret)
+                return ret;
+
+        return read_words(c, buf, len);
+}
+
+static ssize_t do_read_sg(struct am335x_ctrl *c, struct sg_table *sgt, 
+                          size_t len)
+{
+        struct sg_mapping_iter miter;
+        size_t n, total = len;
+        ssize_t ret;
+
+        ret = read_dummy(c);
+        if(ret)
+                return ret;
+
+        sg_miter_start(&miter, sgt->sgl, sgt->orig_nents, SG_MITER_TO_SG);
+        while(len && sg_miter_next(&miter)) {
+                n = min_t(size_t, len, miter.length / sizeof(short));
+                ret = read_words(c, miter.addr, n);
+                if(ret < 0)
+                        break;
+                len -= n;
         }
-        return len;
+        sg_miter_stop(&miter);
+
+        return (ret < 0) ? ret : total;
 }
 
-static ssize_t write(struct controller *ctrl, const unsigned short *buf, size_t len)
+static ssize_t do_write(struct am335x_ctrl *c, const unsigned short *buf, 
+                        size_t len)
 {
         int ret;
-        struct am335x_ctrl *c = to_am335x_ctrl(ctrl);
-        ret = wait_hrdy_timeout(c);
+        ret = wait_hrdy_timeout(c, HRDY_PRE_ADR);
         if(ret) {
                 pr_warn("%s: Read I8080 timeout!\n", THIS_MODULE->name);
                 return -EIO;
@@ -791,13 +2176,13 @@ static ssize_t write(struct controller *ctrl, const unsigned short *buf, size_t
                 write_addr(c, buf[0]);
         
         if(len > 1) {
-                ret = wait_hrdy_timeout(c);
+                ret = wait_hrdy_timeout(c, HRDY_PRE_DATA);
                 if(ret) {
                         pr_warn("%s: Read I8080 timeout!\n", THIS_MODULE->name);
                         return -EIO;
                 }
 
-                if(ctrl->burst_en)
+                if(c->ctrl.burst_en)
                         ret = write_data_no_hrdy(c, &buf[1], len - 1);
                 else
                         ret = write_data(c, &buf[1], len - 1);
@@ -811,6 +2196,441 @@ static ssize_t write(struct controller *ctrl, const unsigned short *buf, size_t
         return 1;
 }
 
+static ssize_t do_write_buf(struct am335x_ctrl *c, unsigned short adr,
+                            size_t offset, size_t len)
+{
+        int ret;
+
+        if(!c->img_buf)
+                return -ENODEV;
+
+        ret = wait_hrdy_timeout(c, HRDY_PRE_ADR);
+        if(ret) {
+                pr_warn("%s: Write I8080 timeout!\n", THIS_MODULE->name);
+                return -EIO;
+        }
+
+        if(adr != __UINT16_MAX__)
+                write_addr(c, adr);
+
+        if(!len)
+                return 0;
+
+        ret = wait_hrdy_timeout(c, HRDY_PRE_DATA);
+        if(ret) {
+                pr_warn("%s: Write I8080 timeout!\n", THIS_MODULE->name);
+                return -EIO;
+        }
+
+        if(c->ctrl.burst_en)
+                ret = write_buf_no_hrdy(c, offset, len);
+        else
+                ret = write_data(c, (const short *)c->img_buf + offset, len);
+
+        if(ret) {
+                pr_warn("%s: Write data failed!\n", THIS_MODULE->name);
+                return ret;
+        }
+        return len;
+}
+
+static ssize_t do_write_sg(struct am335x_ctrl *c, unsigned short adr,
+                           struct sg_table *sgt, size_t len)
+{
+        int ret;
+
+        ret = wait_hrdy_timeout(c, HRDY_PRE_ADR);
+        if(ret) {
+                pr_warn("%s: Write I8080 timeout!\n", THIS_MODULE->name);
+                return -EIO;
+        }
+
+        if(adr != __UINT16_MAX__)
+                write_addr(c, adr);
+
+        if(!len)
+                return 0;
+
+        ret = wait_hrdy_timeout(c, HRDY_PRE_DATA);
+        if(ret) {
+                pr_warn("%s: Write I8080 timeout!\n", THIS_MODULE->name);
+                return -EIO;
+        }
+
+        if(c->ctrl.burst_en)
+                ret = write_sg_no_hrdy(c, sgt, len);
+        else
+                ret = write_sg_pio(c, sgt, len, 1);
+
+        if(ret) {
+                pr_warn("%s: Write data failed!\n", THIS_MODULE->name);
+                return ret;
+        }
+        return len;
+}
+
+/*
+ * The controller operations are counted as one transaction each by the 
+ * statistics.
+ */
+static ssize_t read(struct controller *ctrl, unsigned short *buf, size_t len)
+{
+        struct am335x_ctrl *c = to_am335x_ctrl(ctrl);
+        u64 start = stats_begin(c);
+        ssize_t ret = do_read(c, buf, len);
+
+        stats_end(c, start);
+        return ret;
+}
+
+static ssize_t read_cont(struct controller *ctrl, unsigned short *buf, 
+                         size_t len)
+{
+        struct am335x_ctrl *c = to_am335x_ctrl(ctrl);
+        u64 start = stats_begin(c);
+        ssize_t ret = read_words(c, buf, len);
+
+        stats_end(c, start);
+        return ret;
+}
+
+static ssize_t read_sg(struct controller *ctrl, struct sg_table *sgt, 
+                       size_t len)
+{
+        struct am335x_ctrl *c = to_am335x_ctrl(ctrl);
+        u64 start = stats_begin(c);
+        ssize_t ret = do_read_sg(c, sgt, len);
+
+        stats_end(c, start);
+        return ret;
+}
+
+static ssize_t write(struct controller *ctrl, const unsigned short *buf, 
+                     size_t len)
+{
+        struct am335x_ctrl *c = to_am335x_ctrl(ctrl);
+        u64 start = stats_begin(c);
+        ssize_t ret = do_write(c, buf, len);
+
+        stats_end(c, start);
+        return ret;
+}
+
+static ssize_t write_buf(struct controller *ctrl, unsigned short adr,
+                         size_t offset, size_t len)
+{
+        struct am335x_ctrl *c = to_am335x_ctrl(ctrl);
+        u64 start = stats_begin(c);
+        ssize_t ret = do_write_buf(c, adr, offset, len);
+
+        stats_end(c, start);
+        return ret;
+}
+
+static ssize_t write_sg(struct controller *ctrl, unsigned short adr,
+                        struct sg_table *sgt, size_t len)
+{
+        struct am335x_ctrl *c = to_am335x_ctrl(ctrl);
+        u64 start = stats_begin(c);
+        ssize_t ret = do_write_sg(c, adr, sgt, len);
+
+        stats_end(c, start);
+        return ret;
+}
+
+/*
+ * The register profile runs on CS0, the pixel profile on CS1. Both timing
+ * sets are programmed already, switching only selects the chip select used
+ * by the LIDD accesses and the LCDDMA.
+ */
+static void set_profile(struct controller *ctrl, enum ctrl_profile profile)
+{
+        struct am335x_ctrl *c = to_am335x_ctrl(ctrl);
+        enum lidd_device ld;
+
+        ld = (profile == CTRL_PROFILE_PIXEL) ? LIDD_CS1 : LIDD_CS0;
+        if(c->cs == ld)
+                return;
+
+        c->cs = ld;
+        am335x_shadow_set_dma_cs0_cs1(&c->regs, ld);
+        am335x_shadow_flush(&c->regs);
+}
+
+/*
+ * Timings searched by calibrate(), in the order they are lowered. The write
+ * strobe comes first as it dominates the cycle time.
+ */
+struct cal_param {
+        size_t offs;
+        unsigned char min;
+        unsigned char max;
+        int rd;
+};
+
+static const struct cal_param cal_params[] = {
+        { offsetof(struct am335x_lidd_timings, w_strobe), 1, 63, 0 },
+        { offsetof(struct am335x_lidd_timings, w_setup), 0, 31, 0 },
+        { offsetof(struct am335x_lidd_timings, w_hold), 1, 15, 0 },
+        { offsetof(struct am335x_lidd_timings, ta), 0, 3, 0 },
+        { offsetof(struct am335x_lidd_timings, r_strobe), 1, 63, 1 },
+        { offsetof(struct am335x_lidd_timings, r_setup), 0, 31, 1 },
+        { offsetof(struct am335x_lidd_timings, r_hold), 1, 15, 1 },
+};
+
+static void cal_fill(unsigned short *buf, size_t len, unsigned int pattern)
+{
+        u32 seed = 0x2545f491;
+        size_t i;
+
+        for(i = 0; i < len; i++) {
+                switch(pattern) {
+                case 0:
+                        buf[i] = (i & 1) ? 0xaaaa : 0x5555;
+                        break;
+                case 1:
+                        buf[i] = (i & 1) ? 0xffff : 0x0000;
+                        break;
+                case 2:
+                        buf[i] = 1U << (i % 16);
+                        break;
+                default:
+                        seed = seed * 1103515245 + 12345;
+                        buf[i] = seed >> 16;
+                        break;
+                }
+        }
+}
+
+/*
+ * Writes all test patterns with the profile under test and compares them 
+ * with what the device returns.
+ */
+static int cal_check(struct am335x_ctrl *c, struct pl_par_ioctl_calibrate *cal,
+                     unsigned short *buf, unsigned short *rbuf)
+{
+        unsigned int p;
+        ssize_t ret;
+
+        for(p = 0; p < CAL_PATTERNS; p++) {
+                // a search takes many steps, let it be killed between them
+                if(fatal_signal_pending(current))
+                        return -EINTR;
+
+                buf[0] = cal->wr_adr;
+                cal_fill(&buf[1], cal->words, p);
+
+                if(cal->profile)
+                        set_profile(&c->ctrl, CTRL_PROFILE_PIXEL);
+                ret = write(&c->ctrl, buf, cal->words + 1);
+                set_profile(&c->ctrl, CTRL_PROFILE_REG);
+                if(ret < 0)
+                        return ret;
+
+                ret = write(&c->ctrl, &cal->rd_adr, 1);
+                if(ret < 0)
+                        return ret;
+
+                ret = read(&c->ctrl, rbuf, cal->words);
+                if(ret < 0)
+                        return ret;
+
+                if(memcmp(&buf[1], rbuf, cal->words * sizeof(*buf)))
+                        return -EIO;
+        }
+
+        return 0;
+}
+
+static int cal_try_timings(struct am335x_ctrl *c, 
+                           struct pl_par_ioctl_calibrate *cal,
+                           enum lidd_device ld, struct am335x_lidd_timings *lt,
+                           unsigned short *buf, unsigned short *rbuf)
+{
+        am335x_shadow_set_lidd_timings(&c->regs, ld, lt);
+        am335x_shadow_flush(&c->regs);
+        return cal_check(c, cal, buf, rbuf);
+}
+
+static int cal_try_clkdiv(struct am335x_ctrl *c, 
+                          struct pl_par_ioctl_calibrate *cal, int clk_div,
+                          unsigned short *buf, unsigned short *rbuf)
+{
+        am335x_shadow_set_clkdiv(&c->regs, clk_div);
+        am335x_shadow_flush(&c->regs);
+        return cal_check(c, cal, buf, rbuf);
+}
+
+/*
+ * Lowers the clock divider and then every cycle count by binary search, 
+ * assuming that anything slower than a passing setting passes as well. The
+ * caller has to hold the bus. A failing step gives up on HRDY after 
+ * CAL_HRDY_TIMEOUT_MSECS. On failure the previous settings are restored.
+ */
+static int calibrate(struct controller *ctrl, 
+                     struct pl_par_ioctl_calibrate *cal)
+{
+        struct am335x_ctrl *c = to_am335x_ctrl(ctrl);
+        enum lidd_device ld = cal->profile ? LIDD_CS1 : LIDD_CS0;
+        struct am335x_lidd_timings lt, orig_lt;
+        unsigned short *buf, *rbuf;
+        unsigned char *val;
+        int orig_div, lo, hi, mid, i, ret;
+
+        if(!cal->words || cal->words > CAL_MAX_WORDS || cal->profile > 1 ||
+           cal->margin > 100)
+                return -EINVAL;
+
+        buf = kmalloc_array(cal->words + 1, sizeof(*buf), GFP_KERNEL);
+        rbuf = kmalloc_array(cal->words, sizeof(*rbuf), GFP_KERNEL);
+        if(!buf || !rbuf) {
+                ret = -ENOMEM;
+                goto free_bufs;
+        }
+
+        orig_lt = lt = am335x_shadow_get_lidd_timings(&c->regs, ld);
+        orig_div = am335x_shadow_get_clkdiv(&c->regs);
+        ctrl->xfer_hrdy_timeout = CAL_HRDY_TIMEOUT_MSECS;
+
+        // the current settings have to work, they are the upper bound
+        ret = cal_check(c, cal, buf, rbuf);
+        if(ret) {
+                pr_warn("%s: Calibration baseline failed (%d)!\n", 
+                        THIS_MODULE->name, ret);
+                goto free_bufs;
+        }
+
+        // the clock divider is shared, leave it to the register profile
+        if(!cal->profile) {
+                lo = 1;
+                hi = orig_div;
+                while(lo < hi) {
+                        mid = (lo + hi) / 2;
+                        ret = cal_try_clkdiv(c, cal, mid, buf, rbuf);
+                        if(ret == -EINTR)
+                                goto restore;
+                        if(ret)
+                                lo = mid + 1;
+                        else
+                                hi = mid;
+                }
+                am335x_shadow_set_clkdiv(&c->regs, hi);
+        }
+
+        for(i = 0; i < ARRAY_SIZE(cal_params); i++) {
+                if(cal->profile && cal_params[i].rd)
+                        continue;
+
+                val = (unsigned char *)&lt + cal_params[i].offs;
+                lo = cal_params[i].min;
+                hi = *val;
+                while(lo < hi) {
+                        mid = (lo + hi) / 2;
+                        *val = mid;
+                        ret = cal_try_timings(c, cal, ld, &lt, buf, rbuf);
+                        if(ret == -EINTR)
+                                goto restore;
+                        if(ret)
+                                lo = mid + 1;
+                        else
+                                hi = mid;
+                }
+                *val = hi;
+        }
+
+        // add the safety margin, at least one cycle
+        for(i = 0; cal->margin && i < ARRAY_SIZE(cal_params); i++) {
+                if(cal->profile && cal_params[i].rd)
+                        continue;
+
+                val = (unsigned char *)&lt + cal_params[i].offs;
+                hi = *val + max(1U, *val * cal->margin / 100);
+                *val = min_t(int, hi, cal_params[i].max);
+        }
+
+        ret = cal_try_timings(c, cal, ld, &lt, buf, rbuf);
+        if(ret) {
+                pr_warn("%s: Calibrated timings failed (%d)!\n", 
+                        THIS_MODULE->name, ret);
+                goto restore;
+        }
+
+        cal->clk_div = am335x_shadow_get_clkdiv(&c->regs);
+        cal->w_su = lt.w_setup;
+        cal->w_strobe = lt.w_strobe;
+        cal->w_hold = lt.w_hold;
+        cal->r_su = lt.r_setup;
+        cal->r_strobe = lt.r_strobe;
+        cal->r_hold = lt.r_hold;
+        cal->cs_delay = lt.ta;
+        goto free_bufs;
+
+restore:
+        am335x_shadow_set_clkdiv(&c->regs, orig_div);
+        am335x_shadow_set_lidd_timings(&c->regs, ld, &orig_lt);
+        am335x_shadow_flush(&c->regs);
+free_bufs:
+        ctrl->xfer_hrdy_timeout = 0;
+        kfree(rbuf);
+        kfree(buf);
+        return ret;
+}
+
+static int mmap(struct controller *ctrl, struct vm_area_struct *vma)
+{
+        struct am335x_ctrl *c = to_am335x_ctrl(ctrl);
+        size_t size = vma->vm_end - vma->vm_start;
+
+        if(!c->img_buf)
+                return -ENODEV;
+
+        if(vma->vm_pgoff || size > ctrl->buf_size)
+                return -EINVAL;
+
+        return dma_mmap_coherent(c->dev, vma, c->img_buf, c->img_buf_dma, 
+                                 size);
+}
+
+static int poll_ready(struct controller *ctrl, struct file *file, 
+                      poll_table *wait)
+{
+        struct am335x_ctrl *c = to_am335x_ctrl(ctrl);
+
+        if(gpiod_get_value(c->hrdy_gpio))
+                return 1;
+
+        if(!wait)
+                return 0;
+
+        poll_wait(file, &c->hrdy_wq, wait);
+        if(!test_and_set_bit(0, &c->hrdy_poll_armed))
+                hrdy_irq_get(c);
+
+        // HRDY may have been asserted before the IRQ got enabled
+        return gpiod_get_value(c->hrdy_gpio);
+}
+
+static int wait_ready(struct controller *ctrl)
+{
+        int ret;
+
+        ret = wait_hrdy_timeout(to_am335x_ctrl(ctrl), HRDY_PRE_ADR);
+        if(ret) {
+                pr_warn("%s: HRDY timeout!\n", THIS_MODULE->name);
+                return -EIO;
+        }
+        return 0;
+}
+
+static void debugfs_init(struct controller *ctrl, struct dentry *dir)
+{
+        struct am335x_ctrl *c = to_am335x_ctrl(ctrl);
+
+        debugfs_create_file("stats", 0444, dir, c, &stats_fops);
+        debugfs_create_file_unsafe("stats_reset", 0200, dir, c, 
+                                   &stats_reset_fops);
+}
+
 struct controller *am335x_ctrl_create(void)
 {
         struct am335x_ctrl *ctrl;
@@ -822,8 +2642,20 @@ struct controller *am335x_ctrl_create(void)
 
         ctrl->ctrl.init = init;
         ctrl->ctrl.read = read;
+        ctrl->ctrl.read_cont = read_cont;
         ctrl->ctrl.write = write;
+        ctrl->ctrl.write_buf = write_buf;
+        ctrl->ctrl.read_sg = read_sg;
+        ctrl->ctrl.write_sg = write_sg;
+        ctrl->ctrl.set_profile = set_profile;
+        ctrl->ctrl.calibrate = calibrate;
+        ctrl->ctrl.mmap = mmap;
+        ctrl->ctrl.poll_ready = poll_ready;
+        ctrl->ctrl.wait_ready = wait_ready;
+        ctrl->ctrl.debugfs_init = debugfs_init;
         ctrl->ctrl.destroy = destroy;
+        ctrl->ctrl.hrdy_interval = 1;
+        ctrl->ctrl.read_hrdy_interval = 1;
 
         return &ctrl->ctrl;
 }
\ No newline at end of file
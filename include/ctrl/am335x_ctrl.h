@@ -21,20 +21,115 @@
 #include <linux/string.h>
 #include <linux/platform_device.h>
 #include <linux/gpio/consumer.h>
+#include <linux/completion.h>
+#include <linux/dma-mapping.h>
+#include <linux/interrupt.h>
+#include <linux/wait.h>
+#include <linux/sizes.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/notifier.h>
 
 #include <ctrl/controller.h>
+#include <ctrl/am335x_regs.h>
 
 #define AM335X_TCON_CLK_IDENTIFIER      "l4_per_cm:clk:0004:0"
+#define AM335X_IMG_BUF_SIZE_PROP        "img-buf-size"
+#define AM335X_DMA_CHUNK_SIZE           SZ_64K
+#define AM335X_TIMINGS_NS_PROP          "timings-ns"
+#define AM335X_PIXEL_TIMINGS_NS_PROP    "pixel-timings-ns"
+#define AM335X_TIMINGS_NS_COUNT         7
+
+/* Bus phases the driver waits for HRDY in */
+enum hrdy_phase {
+        HRDY_PRE_ADR = 0,
+        HRDY_PRE_DATA = 1,
+        HRDY_WORD = 2,
+        HRDY_PHASE_COUNT,
+};
+
+#define AM335X_HRDY_HIST_BUCKETS        32
+
+/*
+ * Bus statistics. Bucket 0 of the HRDY histogram counts the waits which found
+ * HRDY ready, bucket n > 0 the waits of 2^(n-1) ns or longer.
+ */
+struct am335x_stats {
+        u64 transactions;
+        u64 dma_words;
+        u64 pio_words;
+        u64 words_read;
+        u64 busy_ns;
+        u64 idle_ns;
+        u64 last_end_ns;
+        u64 hrdy_timeouts;
+        u64 hrdy_hist[HRDY_PHASE_COUNT][AM335X_HRDY_HIST_BUCKETS];
+};
+
+/*
+ * Minimum LIDD timings of a device in nanoseconds, in the order of the 
+ * device tree properties.
+ */
+struct am335x_lidd_timings_ns {
+        u32 w_setup;
+        u32 w_strobe;
+        u32 w_hold;
+        u32 r_setup;
+        u32 r_strobe;
+        u32 r_hold;
+        u32 ta;
+};
+
+/*
+ * State of a ping-pong LCDDMA transfer. Chunk i of a stream is kept in 
+ * ping-pong buffer (i & 1) and transferred from frame buffer 
+ * ((i - first) & 1), first being the chunk the engine was (re)started with.
+ * queued counts the chunks handed to the hardware, done the chunks it has 
+ * finished. lock serializes the frame mode switches with the interrupt.
+ */
+struct am335x_dma_stream {
+        wait_queue_head_t wq;
+        spinlock_t lock;
+        unsigned int total;
+        unsigned int first;
+        unsigned int queued;
+        unsigned int done;
+        int running;
+        int error;
+        int active;
+};
 
 struct am335x_ctrl {
         struct controller ctrl;
+        struct device *dev;
         struct device timing_dev;
         struct device pol_dev;
         struct resource *hw_res;
         struct clk *hw_clk;
         struct gpio_desc *hrdy_gpio;
         void __iomem *reg_base_addr;
+        struct am335x_lcdc_shadow regs;
+        enum lidd_device cs;
+        struct mutex timing_lock;
+        struct am335x_lidd_timings_ns timings_ns[2];
+        unsigned long timings_ns_set;
+        struct notifier_block clk_nb;
         int irq_num;
+        struct completion dma_done;
+        int hrdy_irq;
+        spinlock_t hrdy_lock;
+        unsigned int hrdy_irq_users;
+        unsigned long hrdy_poll_armed;
+        wait_queue_head_t hrdy_wq;
+        unsigned int hrdy_spin_max_ns;
+        unsigned int hrdy_spin_ns;
+        unsigned int hrdy_wait_avg_ns;
+        void *img_buf;
+        dma_addr_t img_buf_dma;
+        void *dma_chunk[2];
+        dma_addr_t dma_chunk_dma[2];
+        struct am335x_dma_stream stream;
+        struct am335x_stats stats;
 };
 #define to_am335x_ctrl(x) container_of(x, struct am335x_ctrl, ctrl)
 
@@ -14,8 +14,11 @@
 #define AM335X_REGS_H
 
 #include <linux/kernel.h>
+#include <linux/types.h>
 #include <asm-generic/io.h>
 #include <linux/ioport.h>
+#include <linux/bitops.h>
+#include <linux/spinlock.h>
 
 #define SET_BIT(val, n) ((val) |= 1U << (n))
 #define CLEAR_BIT(val, n) ((val) &= ~(1U << (n)))
@@ -44,6 +47,7 @@
 #define AM335X_LCDC_IRQSTATUS_OFFS              0x5CU
 #define AM335X_LCDC_IRQENABLE_SET_OFFS          0x60U
 #define AM335X_LCDC_IRQENABLE_CLEAR_OFFS        0x64U
+#define AM335X_LCDC_EOI_OFFS                    0x68U
 #define AM335X_LCDC_CLKC_ENABLE_OFFS            0x6CU
 #define AM335X_LCDC_CLKC_RESET_OFFS             0x70U
 
@@ -787,6 +791,14 @@ static inline short am335x_get_lidd_data(void __iomem *base_addr,
         return ioread16(base_addr + get_lidd_csx_data_offs(ld));
 }
 
+// back to back reads of the data register, one bus read cycle each
+static inline void am335x_get_lidd_data_rep(void __iomem *base_addr,
+                                            enum lidd_device ld, 
+                                            unsigned short *buf, size_t len)
+{
+        ioread16_rep(base_addr + get_lidd_csx_data_offs(ld), buf, len);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // LCDDMA registers
 
@@ -896,27 +908,27 @@ static inline void am335x_set_lcddma_master_prio(void __iomem *base_addr,
 
 
 static inline void am335x_set_lcddma_fb0_base_addr(void __iomem *base_addr,
-                                                   const void *base)
+                                                   dma_addr_t base)
 {
-        writel((uintptr_t)base, base_addr +  AM335X_LCDC_LCDDMA_FB0_BASE_OFFS);
+        writel(base, base_addr +  AM335X_LCDC_LCDDMA_FB0_BASE_OFFS);
 }
 
 static inline void am335x_set_lcddma_fb1_base_addr(void __iomem *base_addr,
-                                                   const void *base)
+                                                   dma_addr_t base)
 {
-        writel((uintptr_t)base, base_addr +  AM335X_LCDC_LCDDMA_FB1_BASE_OFFS);
+        writel(base, base_addr +  AM335X_LCDC_LCDDMA_FB1_BASE_OFFS);
 }
 
 static inline void am335x_set_lcddma_fb0_ceil_addr(void __iomem *base_addr,
-                                                   const void *ceil)
+                                                   dma_addr_t ceil)
 {
-        writel((uintptr_t)ceil, base_addr + AM335X_LCDC_LCDDMA_FB0_CEIL_OFFS);
+        writel(ceil, base_addr + AM335X_LCDC_LCDDMA_FB0_CEIL_OFFS);
 }
 
 static inline void am335x_set_lcddma_fb1_ceil_addr(void __iomem *base_addr,
-                                                   const void *ceil)
+                                                   dma_addr_t ceil)
 {
-        writel((uintptr_t)ceil, base_addr + AM335X_LCDC_LCDDMA_FB1_CEIL_OFFS);
+        writel(ceil, base_addr + AM335X_LCDC_LCDDMA_FB1_CEIL_OFFS);
 }
 
 union am335x_lcddma_irqstatus_raw_reg {
@@ -991,6 +1003,26 @@ static inline int am335x_get_lcddma_fbx_eof_raw_irq(void __iomem *base_addr,
 #define AM335X_LCDDMA_IRQ_EOF0_CLR_OFFS                         8
 #define AM335X_LCDDMA_IRQ_EOF1_CLR_OFFS                         9
 
+#define AM335X_LCDDMA_IRQ_DONE          BIT(AM335X_LCDDMA_IRQ_DONE_CLR_OFFS)
+#define AM335X_LCDDMA_IRQ_EOF0          BIT(AM335X_LCDDMA_IRQ_EOF0_CLR_OFFS)
+#define AM335X_LCDDMA_IRQ_EOF1          BIT(AM335X_LCDDMA_IRQ_EOF1_CLR_OFFS)
+
+static inline unsigned am335x_get_lcdc_irqstatus(void __iomem *base_addr)
+{
+        return readl(base_addr + AM335X_LCDC_IRQSTATUS_OFFS);
+}
+
+static inline void am335x_clear_lcdc_irqstatus(void __iomem *base_addr, 
+                                               unsigned mask)
+{
+        writel(mask, base_addr + AM335X_LCDC_IRQSTATUS_OFFS);
+}
+
+static inline void am335x_set_lcdc_eoi(void __iomem *base_addr)
+{
+        writel(0, base_addr + AM335X_LCDC_EOI_OFFS);
+}
+
 static inline int am335x_get_lcddma_done_clr(void __iomem *base_addr)
 {
         unsigned reg = readl(base_addr + AM335X_LCDC_IRQSTATUS_OFFS);
@@ -1059,7 +1091,7 @@ union am335x_lcddma_irqenable_set_reg {
 
 static inline void am335x_set_lcddma_done_en_set(void __iomem *base_addr)
 {
-        union am335x_lcddma_irqenable_set_reg reg;
+        union am335x_lcddma_irqenable_set_reg reg = { .reg_val = 0 };
         reg.done_en_set = 1; 
         writel(reg.reg_val, base_addr + AM335X_LCDC_IRQENABLE_SET_OFFS);
 }
@@ -1067,49 +1099,49 @@ static inline void am335x_set_lcddma_done_en_set(void __iomem *base_addr)
 static inline void am335x_set_lcddma_recurrent_raster_done_en_set(
                                                         void __iomem *base_addr)
 {
-        union am335x_lcddma_irqenable_set_reg reg;
+        union am335x_lcddma_irqenable_set_reg reg = { .reg_val = 0 };
         reg.recurrent_raster_done_en_set = 1; 
         writel(reg.reg_val, base_addr + AM335X_LCDC_IRQENABLE_SET_OFFS);
 }
 
 static inline void am335x_set_lcddma_sync_en_set(void __iomem *base_addr)
 {
-        union am335x_lcddma_irqenable_set_reg reg;
+        union am335x_lcddma_irqenable_set_reg reg = { .reg_val = 0 };
         reg.sync_en_set = 1; 
         writel(reg.reg_val, base_addr + AM335X_LCDC_IRQENABLE_SET_OFFS);
 }
 
 static inline void am335x_set_lcddma_acb_en_set(void __iomem *base_addr)
 {
-        union am335x_lcddma_irqenable_set_reg reg;
+        union am335x_lcddma_irqenable_set_reg reg = { .reg_val = 0 };
         reg.acb_en_set = 1; 
         writel(reg.reg_val, base_addr + AM335X_LCDC_IRQENABLE_SET_OFFS);
 }
 
 static inline void am335x_set_lcddma_fuf_en_set(void __iomem *base_addr)
 {
-        union am335x_lcddma_irqenable_set_reg reg;
+        union am335x_lcddma_irqenable_set_reg reg = { .reg_val = 0 };
         reg.fuf_en_set = 1; 
         writel(reg.reg_val, base_addr + AM335X_LCDC_IRQENABLE_SET_OFFS);
 }
 
 static inline void am335x_set_lcddma_pl_en_set(void __iomem *base_addr)
 {
-        union am335x_lcddma_irqenable_set_reg reg;
+        union am335x_lcddma_irqenable_set_reg reg = { .reg_val = 0 };
         reg.pl_en_set = 1; 
         writel(reg.reg_val, base_addr + AM335X_LCDC_IRQENABLE_SET_OFFS);
 }
 
 static inline void am335x_set_lcddma_eof0_en_set(void __iomem *base_addr)
 {
-        union am335x_lcddma_irqenable_set_reg reg;
+        union am335x_lcddma_irqenable_set_reg reg = { .reg_val = 0 };
         reg.eof0_en_set = 1; 
         writel(reg.reg_val, base_addr + AM335X_LCDC_IRQENABLE_SET_OFFS);
 }
 
 static inline void am335x_set_lcddma_eof1_en_set(void __iomem *base_addr)
 {
-        union am335x_lcddma_irqenable_set_reg reg;
+        union am335x_lcddma_irqenable_set_reg reg = { .reg_val = 0 };
         reg.eof1_en_set = 1; 
         writel(reg.reg_val, base_addr + AM335X_LCDC_IRQENABLE_SET_OFFS);
 }
@@ -1133,7 +1165,7 @@ union am335x_lcddma_irqenable_clr_reg {
 
 static inline void am335x_set_lcddma_done_en_clr(void __iomem *base_addr)
 {
-        union am335x_lcddma_irqenable_clr_reg reg;
+        union am335x_lcddma_irqenable_clr_reg reg = { .reg_val = 0 };
         reg.done_en_clr = 1;
         writel(reg.reg_val, base_addr + AM335X_LCDC_IRQENABLE_CLEAR_OFFS);
 }
@@ -1141,51 +1173,393 @@ static inline void am335x_set_lcddma_done_en_clr(void __iomem *base_addr)
 static inline void am335x_set_lcddma_recurrent_raster_done_en_clr(
                                                         void __iomem *base_addr)
 {
-        union am335x_lcddma_irqenable_clr_reg reg;
+        union am335x_lcddma_irqenable_clr_reg reg = { .reg_val = 0 };
         reg.recurrent_raster_done_en_clr = 1;
         writel(reg.reg_val, base_addr + AM335X_LCDC_IRQENABLE_CLEAR_OFFS);
 }
 
 static inline void am335x_set_lcddma_sync_en_clr(void __iomem *base_addr)
 {
-        union am335x_lcddma_irqenable_clr_reg reg;
+        union am335x_lcddma_irqenable_clr_reg reg = { .reg_val = 0 };
         reg.sync_en_clr = 1;
         writel(reg.reg_val, base_addr + AM335X_LCDC_IRQENABLE_CLEAR_OFFS);
 }
 
 static inline void am335x_set_lcddma_acb_en_clr(void __iomem *base_addr)
 {
-        union am335x_lcddma_irqenable_clr_reg reg;
+        union am335x_lcddma_irqenable_clr_reg reg = { .reg_val = 0 };
         reg.acb_en_clr = 1;
         writel(reg.reg_val, base_addr + AM335X_LCDC_IRQENABLE_CLEAR_OFFS);
 }
 
 static inline void am335x_set_lcddma_fuf_en_clr(void __iomem *base_addr)
 {
-        union am335x_lcddma_irqenable_clr_reg reg;
+        union am335x_lcddma_irqenable_clr_reg reg = { .reg_val = 0 };
         reg.fuf_en_clr = 1;
         writel(reg.reg_val, base_addr + AM335X_LCDC_IRQENABLE_CLEAR_OFFS);
 }
 
 static inline void am335x_set_lcddma_pl_en_clr(void __iomem *base_addr)
 {
-        union am335x_lcddma_irqenable_clr_reg reg;
+        union am335x_lcddma_irqenable_clr_reg reg = { .reg_val = 0 };
         reg.pl_en_clr = 1;
         writel(reg.reg_val, base_addr + AM335X_LCDC_IRQENABLE_CLEAR_OFFS);
 }
 
 static inline void am335x_set_lcddma_eof0_en_clr(void __iomem *base_addr)
 {
-        union am335x_lcddma_irqenable_clr_reg reg;
+        union am335x_lcddma_irqenable_clr_reg reg = { .reg_val = 0 };
         reg.eof0_en_clr = 1;
         writel(reg.reg_val, base_addr + AM335X_LCDC_IRQENABLE_CLEAR_OFFS);
 }
 
 static inline void am335x_set_lcddma_eof1_en_clr(void __iomem *base_addr)
 {
-        union am335x_lcddma_irqenable_clr_reg reg;
+        union am335x_lcddma_irqenable_clr_reg reg = { .reg_val = 0 };
         reg.eof1_en_clr = 1;
         writel(reg.reg_val, base_addr + AM335X_LCDC_IRQENABLE_CLEAR_OFFS);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Shadow registers
+
+/*
+ * In-memory copies of the LCDC configuration registers. The LCDC never 
+ * changes them on its own, so the setters below only update the copy and 
+ * am335x_shadow_flush() writes each modified register once. Getters don't 
+ * touch the hardware at all.
+ */
+enum am335x_shadow_reg {
+        SHADOW_CTRL = 0,
+        SHADOW_LIDD_CTRL = 1,
+        SHADOW_CS0_CONF = 2,
+        SHADOW_CS1_CONF = 3,
+        SHADOW_LCDDMA_CTRL = 4,
+        SHADOW_REG_COUNT = 5,
+};
+
+struct am335x_lcdc_shadow {
+        void __iomem *base_addr;
+        spinlock_t lock;
+        uint32_t val[SHADOW_REG_COUNT];
+        unsigned long dirty;
+};
+
+#define get_shadow_csx_conf(ld) \
+        (ld == LIDD_CS0 ? SHADOW_CS0_CONF : SHADOW_CS1_CONF)
+
+static inline unsigned int am335x_shadow_offs(enum am335x_shadow_reg r)
+{
+        switch(r) {
+        case SHADOW_CTRL:
+                return AM335X_LCDC_CTRL_OFFS;
+        case SHADOW_LIDD_CTRL:
+                return AM335X_LCDC_LIDD_CTRL_OFFS;
+        case SHADOW_CS0_CONF:
+                return AM335X_LCDC_LIDD_CS0_CONF_OFFS;
+        case SHADOW_CS1_CONF:
+                return AM335X_LCDC_LIDD_CS1_CONF_OFFS;
+        default:
+                return AM335X_LCDC_LCDDMA_CTRL_OFFS;
+        }
+}
+
+static inline void am335x_shadow_init(struct am335x_lcdc_shadow *sh,
+                                      void __iomem *base_addr)
+{
+        int r;
+
+        sh->base_addr = base_addr;
+        spin_lock_init(&sh->lock);
+        sh->dirty = 0;
+        for(r = 0; r < SHADOW_REG_COUNT; r++)
+                sh->val[r] = readl(base_addr + am335x_shadow_offs(r));
+}
+
+static inline void am335x_shadow_update(struct am335x_lcdc_shadow *sh,
+                                        enum am335x_shadow_reg r,
+                                        uint32_t mask, uint32_t val)
+{
+        unsigned long flags;
+
+        spin_lock_irqsave(&sh->lock, flags);
+        sh->val[r] = (sh->val[r] & ~mask) | (val & mask);
+        __set_bit(r, &sh->dirty);
+        spin_unlock_irqrestore(&sh->lock, flags);
+}
+
+static inline uint32_t am335x_shadow_get(struct am335x_lcdc_shadow *sh,
+                                         enum am335x_shadow_reg r)
+{
+        return READ_ONCE(sh->val[r]);
+}
+
+static inline void am335x_shadow_flush(struct am335x_lcdc_shadow *sh)
+{
+        unsigned long flags;
+        int r;
+
+        spin_lock_irqsave(&sh->lock, flags);
+        for_each_set_bit(r, &sh->dirty, SHADOW_REG_COUNT)
+                writel(sh->val[r], sh->base_addr + am335x_shadow_offs(r));
+        sh->dirty = 0;
+        spin_unlock_irqrestore(&sh->lock, flags);
+}
+
+/* ctrl */
+
+static inline void am335x_shadow_set_ctrl_mode(struct am335x_lcdc_shadow *sh,
+                                               enum lcd_mode mode)
+{
+        union am335x_lcdc_ctrl_reg keep = { .reg_val = ~0U };
+        union am335x_lcdc_ctrl_reg reg = { .reg_val = 0 };
+        keep.modesel = 0;
+        reg.modesel = mode;
+        am335x_shadow_update(sh, SHADOW_CTRL, ~keep.reg_val, reg.reg_val);
+}
+
+static inline void am335x_shadow_set_clkdiv(struct am335x_lcdc_shadow *sh,
+                                            unsigned int clk_div)
+{
+        union am335x_lcdc_ctrl_reg keep = { .reg_val = ~0U };
+        union am335x_lcdc_ctrl_reg reg = { .reg_val = 0 };
+        keep.clkdiv = 0;
+        reg.clkdiv = clk_div;
+        am335x_shadow_update(sh, SHADOW_CTRL, ~keep.reg_val, reg.reg_val);
+}
+
+static inline int am335x_shadow_get_clkdiv(struct am335x_lcdc_shadow *sh)
+{
+        union am335x_lcdc_ctrl_reg reg;
+        reg.reg_val = am335x_shadow_get(sh, SHADOW_CTRL);
+        return reg.clkdiv;
+}
+
+/* lidd ctrl */
+
+static inline void am335x_shadow_set_lidd_ctrl_bit(
+                                                struct am335x_lcdc_shadow *sh,
+                                                unsigned int n, unsigned b)
+{
+        am335x_shadow_update(sh, SHADOW_LIDD_CTRL, BIT(n), b ? BIT(n) : 0);
+}
+
+static inline void am335x_shadow_set_lidd_mode(struct am335x_lcdc_shadow *sh,
+                                               enum lidd_mode mode)
+{
+        am335x_shadow_update(sh, SHADOW_LIDD_CTRL, 
+                             7U << AM335X_LIDD_MODE_SEL_OFFS,
+                             mode << AM335X_LIDD_MODE_SEL_OFFS);
+}
+
+static inline void am335x_shadow_set_lidd_dma_en(struct am335x_lcdc_shadow *sh,
+                                                 unsigned enable)
+{
+        am335x_shadow_set_lidd_ctrl_bit(sh, AM335X_LIDD_DMA_EN_OFFS, enable);
+}
+
+static inline void am335x_shadow_set_dma_cs0_cs1(struct am335x_lcdc_shadow *sh,
+                                                 enum lidd_device ld)
+{
+        am335x_shadow_set_lidd_ctrl_bit(sh, AM335X_DMA_CS0_CS1_OFFS, ld);
+}
+
+static inline void am335x_shadow_set_lidd_pols(struct am335x_lcdc_shadow *sh,
+                                               struct am335x_lidd_sig_pol *pols)
+{
+        unsigned mask = 0, reg = 0;
+        SET_BIT(mask, AM335X_ALEPOL_OFFS);
+        SET_BIT(mask, AM335X_CS0_E0_POL_OFFS);
+        SET_BIT(mask, AM335X_CS1_E1_POL_OFFS);
+        SET_BIT(mask, AM335X_RS_EN_POL_OFFS);
+        SET_BIT(mask, AM335X_WS_DIR_POL_OFFS);
+        WRITE_REG_BIT(reg, pols->ale_pol, AM335X_ALEPOL_OFFS);
+        WRITE_REG_BIT(reg, pols->cs0_e0_pol, AM335X_CS0_E0_POL_OFFS);
+        WRITE_REG_BIT(reg, pols->cs1_e1_pol, AM335X_CS1_E1_POL_OFFS);
+        WRITE_REG_BIT(reg, pols->rs_en_pol, AM335X_RS_EN_POL_OFFS);
+        WRITE_REG_BIT(reg, pols->ws_dir_pol, AM335X_WS_DIR_POL_OFFS);
+        am335x_shadow_update(sh, SHADOW_LIDD_CTRL, mask, reg);
+}
+
+static inline struct am335x_lidd_sig_pol am335x_shadow_get_lidd_pols(
+                                                struct am335x_lcdc_shadow *sh)
+{
+        struct am335x_lidd_sig_pol pols;
+        unsigned reg = am335x_shadow_get(sh, SHADOW_LIDD_CTRL);
+        pols.ale_pol = READ_REG_BIT(reg, AM335X_ALEPOL_OFFS);
+        pols.cs0_e0_pol = READ_REG_BIT(reg, AM335X_CS0_E0_POL_OFFS);
+        pols.cs1_e1_pol = READ_REG_BIT(reg, AM335X_CS1_E1_POL_OFFS);
+        pols.rs_en_pol = READ_REG_BIT(reg, AM335X_RS_EN_POL_OFFS);
+        pols.ws_dir_pol = READ_REG_BIT(reg, AM335X_WS_DIR_POL_OFFS);
+        return pols;
+}
+
+/* lidd csx conf */
+
+static inline void am335x_shadow_set_lidd_timings(struct am335x_lcdc_shadow *sh,
+                                                  enum lidd_device ld,
+                                                  struct am335x_lidd_timings *lt)
+{
+        union am335x_lcdc_lidd_csx_conf_reg reg;
+        reg.r_hold = lt->r_hold;
+        reg.r_strobe = lt->r_strobe;
+        reg.r_su = lt->r_setup;
+        reg.w_hold = lt->w_hold;
+        reg.w_strobe = lt->w_strobe;
+        reg.w_su = lt->w_setup;
+        reg.ta = lt->ta;
+        am335x_shadow_update(sh, get_shadow_csx_conf(ld), ~0U, reg.reg_val);
+}
+
+static inline void am335x_shadow_set_lidd_ta(
+                                                struct am335x_lcdc_shadow *sh,
+                                                enum lidd_device ld, int ta)
+{
+        union am335x_lcdc_lidd_csx_conf_reg keep = { .reg_val = ~0U };
+        union am335x_lcdc_lidd_csx_conf_reg reg = { .reg_val = 0 };
+        keep.ta = 0;
+        reg.ta = ta;
+        am335x_shadow_update(sh, get_shadow_csx_conf(ld), ~keep.reg_val, 
+                             reg.reg_val);
+}
+
+static inline void am335x_shadow_set_lidd_r_hold(
+                                                struct am335x_lcdc_shadow *sh,
+                                                enum lidd_device ld, int r_hold)
+{
+        union am335x_lcdc_lidd_csx_conf_reg keep = { .reg_val = ~0U };
+        union am335x_lcdc_lidd_csx_conf_reg reg = { .reg_val = 0 };
+        keep.r_hold = 0;
+        reg.r_hold = r_hold;
+        am335x_shadow_update(sh, get_shadow_csx_conf(ld), ~keep.reg_val, 
+                             reg.reg_val);
+}
+
+static inline void am335x_shadow_set_lidd_r_strobe(
+                                                struct am335x_lcdc_shadow *sh,
+                                                enum lidd_device ld, int r_strobe)
+{
+        union am335x_lcdc_lidd_csx_conf_reg keep = { .reg_val = ~0U };
+        union am335x_lcdc_lidd_csx_conf_reg reg = { .reg_val = 0 };
+        keep.r_strobe = 0;
+        reg.r_strobe = r_strobe;
+        am335x_shadow_update(sh, get_shadow_csx_conf(ld), ~keep.reg_val, 
+                             reg.reg_val);
+}
+
+static inline void am335x_shadow_set_lidd_r_su(
+                                                struct am335x_lcdc_shadow *sh,
+                                                enum lidd_device ld, int r_su)
+{
+        union am335x_lcdc_lidd_csx_conf_reg keep = { .reg_val = ~0U };
+        union am335x_lcdc_lidd_csx_conf_reg reg = { .reg_val = 0 };
+        keep.r_su = 0;
+        reg.r_su = r_su;
+        am335x_shadow_update(sh, get_shadow_csx_conf(ld), ~keep.reg_val, 
+                             reg.reg_val);
+}
+
+static inline void am335x_shadow_set_lidd_w_hold(
+                                                struct am335x_lcdc_shadow *sh,
+                                                enum lidd_device ld, int w_hold)
+{
+        union am335x_lcdc_lidd_csx_conf_reg keep = { .reg_val = ~0U };
+        union am335x_lcdc_lidd_csx_conf_reg reg = { .reg_val = 0 };
+        keep.w_hold = 0;
+        reg.w_hold = w_hold;
+        am335x_shadow_update(sh, get_shadow_csx_conf(ld), ~keep.reg_val, 
+                             reg.reg_val);
+}
+
+static inline void am335x_shadow_set_lidd_w_strobe(
+                                                struct am335x_lcdc_shadow *sh,
+                                                enum lidd_device ld, int w_strobe)
+{
+        union am335x_lcdc_lidd_csx_conf_reg keep = { .reg_val = ~0U };
+        union am335x_lcdc_lidd_csx_conf_reg reg = { .reg_val = 0 };
+        keep.w_strobe = 0;
+        reg.w_strobe = w_strobe;
+        am335x_shadow_update(sh, get_shadow_csx_conf(ld), ~keep.reg_val, 
+                             reg.reg_val);
+}
+
+static inline void am335x_shadow_set_lidd_w_su(
+                                                struct am335x_lcdc_shadow *sh,
+                                                enum lidd_device ld, int w_su)
+{
+        union am335x_lcdc_lidd_csx_conf_reg keep = { .reg_val = ~0U };
+        union am335x_lcdc_lidd_csx_conf_reg reg = { .reg_val = 0 };
+        keep.w_su = 0;
+        reg.w_su = w_su;
+        am335x_shadow_update(sh, get_shadow_csx_conf(ld), ~keep.reg_val, 
+                             reg.reg_val);
+}
+
+static inline struct am335x_lidd_timings am335x_shadow_get_lidd_timings(
+                                                struct am335x_lcdc_shadow *sh,
+                                                enum lidd_device ld)
+{
+        union am335x_lcdc_lidd_csx_conf_reg reg;
+        struct am335x_lidd_timings lt;
+        reg.reg_val = am335x_shadow_get(sh, get_shadow_csx_conf(ld));
+        lt.r_hold = reg.r_hold;
+        lt.r_strobe = reg.r_strobe;
+        lt.r_setup = reg.r_su;
+        lt.w_hold = reg.w_hold;
+        lt.w_strobe = reg.w_strobe;
+        lt.w_setup = reg.w_su;
+        lt.ta = reg.ta;
+        return lt;
+}
+
+/* lcddma ctrl */
+
+static inline void am335x_shadow_set_lcddma_frame_mode(
+                                                struct am335x_lcdc_shadow *sh,
+                                                enum dma_frame_mode mode)
+{
+        union am335x_lcdc_lcddma_ctrl_reg keep = { .reg_val = ~0U };
+        union am335x_lcdc_lcddma_ctrl_reg reg = { .reg_val = 0 };
+        keep.frame_mode = 0;
+        reg.frame_mode = mode;
+        am335x_shadow_update(sh, SHADOW_LCDDMA_CTRL, ~keep.reg_val, 
+                             reg.reg_val);
+}
+
+static inline void am335x_shadow_set_lcddma_burst_size(
+                                                struct am335x_lcdc_shadow *sh,
+                                                enum dma_burst_size bs)
+{
+        union am335x_lcdc_lcddma_ctrl_reg keep = { .reg_val = ~0U };
+        union am335x_lcdc_lcddma_ctrl_reg reg = { .reg_val = 0 };
+        keep.burst_size = 0;
+        reg.burst_size = bs;
+        am335x_shadow_update(sh, SHADOW_LCDDMA_CTRL, ~keep.reg_val, 
+                             reg.reg_val);
+}
+
+static inline void am335x_shadow_set_lcddma_fifo_threshold(
+                                                struct am335x_lcdc_shadow *sh,
+                                                enum dma_fifo_threshold ft)
+{
+        union am335x_lcdc_lcddma_ctrl_reg keep = { .reg_val = ~0U };
+        union am335x_lcdc_lcddma_ctrl_reg reg = { .reg_val = 0 };
+        keep.th_fifo_ready = 0;
+        reg.th_fifo_ready = ft;
+        am335x_shadow_update(sh, SHADOW_LCDDMA_CTRL, ~keep.reg_val, 
+                             reg.reg_val);
+}
+
+static inline void am335x_shadow_set_lcddma_master_prio(
+                                                struct am335x_lcdc_shadow *sh,
+                                                enum dma_master_prio mp)
+{
+        union am335x_lcdc_lcddma_ctrl_reg keep = { .reg_val = ~0U };
+        union am335x_lcdc_lcddma_ctrl_reg reg = { .reg_val = 0 };
+        keep.dma_master_prio = 0;
+        reg.dma_master_prio = mp;
+        am335x_shadow_update(sh, SHADOW_LCDDMA_CTRL, ~keep.reg_val, 
+                             reg.reg_val);
+}
+
 #endif /* AM335X_REGS_H */
\ No newline at end of file
@@ -16,18 +16,66 @@
 #include <linux/kobject.h>
 #include <linux/clk.h>
 #include <linux/ioport.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
+#include <linux/scatterlist.h>
+#include <linux/debugfs.h>
+
+#include <pl_par_ioctl.h>
 
 #define PAR_CTRL_NAME   "tcon"
 #define HRDY_GPIO_ID    "hrdy"
 
+/*
+ * Timing profiles. The register profile is used for commands and readback,
+ * the pixel profile can be selected for bulk data writes.
+ */
+enum ctrl_profile {
+        CTRL_PROFILE_REG = 0,
+        CTRL_PROFILE_PIXEL = 1,
+};
+
+/*
+ * The sysfs entries of a controller are created below parent. If init() 
+ * fails, the controller object is freed as well.
+ */
 struct controller {
         int (*init)(struct controller *ctrl, struct platform_device *pdev, 
-                struct class *c);
+                struct device *parent);
         ssize_t (*read)(struct controller *ctrl, unsigned short *buf, size_t len);
+        ssize_t (*read_cont)(struct controller *ctrl, unsigned short *buf, 
+                             size_t len);
         ssize_t (*write)(struct controller *ctrl, const unsigned short *buf, size_t len);
+        ssize_t (*write_buf)(struct controller *ctrl, unsigned short adr,
+                             size_t offset, size_t len);
+        ssize_t (*read_sg)(struct controller *ctrl, struct sg_table *sgt,
+                           size_t len);
+        ssize_t (*write_sg)(struct controller *ctrl, unsigned short adr,
+                            struct sg_table *sgt, size_t len);
+        void (*set_profile)(struct controller *ctrl, 
+                            enum ctrl_profile profile);
+        int (*calibrate)(struct controller *ctrl, 
+                         struct pl_par_ioctl_calibrate *cal);
+        int (*mmap)(struct controller *ctrl, struct vm_area_struct *vma);
+        int (*poll_ready)(struct controller *ctrl, struct file *file,
+                          poll_table *wait);
+        int (*wait_ready)(struct controller *ctrl);
+        void (*debugfs_init)(struct controller *ctrl, struct dentry *dir);
         void (*destroy)(struct controller *ctrl, struct platform_device *pdev,
-                        struct class *c);
+                        struct device *parent);
+        // set by the bus owner before init(), keep transfers off the bus
+        int (*bus_lock)(void *bus_data);
+        void (*bus_unlock)(void *bus_data);
+        void *bus_data;
         int burst_en;
+        unsigned int hrdy_interval;
+        // overrides hrdy_interval for one transaction, 0 if unused
+        unsigned int xfer_hrdy_interval;
+        // overrides the HRDY timeout (ms) for one transaction, 0 if unused
+        unsigned int xfer_hrdy_timeout;
+        unsigned int read_hrdy_interval;
+        void *buf;
+        size_t buf_size;
 };
 
 #endif /* CONTROLLER_H */
\ No newline at end of file
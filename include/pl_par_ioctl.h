@@ -12,6 +12,9 @@
 #ifndef PL_PAR_IOCTL_H
 #define PL_PAR_IOCTL_H
 
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
 #define V1_0
 
 enum pl_par_rw {
@@ -23,6 +26,16 @@ struct pl_par_ioctl_message;
 
 #ifdef V1_0
 
+#define PL_PAR_IOCTL_MAGIC              'p'
+#define PL_PAR_IOCTL_MAX_MSGS           256
+
+/*
+ * A single bus message. data_size is given in 16-bit words. For reads the
+ * address (if not disabled) is sent first and data_size words are read back
+ * into data afterwards. Writes with pixel_profile set use the pixel timing
+ * profile. A non-zero hrdy_interval overrides the HRDY check interval of the
+ * bus for the data of a write.
+ */
 struct pl_par_ioctl_message {
         unsigned short adr;
         short *data;
@@ -30,8 +43,252 @@ struct pl_par_ioctl_message {
         enum pl_par_rw rd_wr;
         unsigned int disable_adr_send : 1;
         unsigned int disable_data_send : 1;
+        unsigned int pixel_profile : 1;
+        unsigned int hrdy_interval;
+};
+
+/*
+ * Batch of messages executed back-to-back without releasing the bus.
+ * The ioctl returns the number of executed messages or a negative error.
+ */
+struct pl_par_ioctl_transfer {
+        struct pl_par_ioctl_message *msgs;
+        unsigned int nmsgs;
+};
+
+#define PL_PAR_IOCTL_TRANSFER \
+        _IOWR(PL_PAR_IOCTL_MAGIC, 0x01, struct pl_par_ioctl_transfer)
+
+/*
+ * Sends size bytes starting at offset of the mmap'ed image buffer as data
+ * after the address adr. offset and size have to be 16-bit aligned.
+ */
+struct pl_par_ioctl_flush {
+        unsigned short adr;
+        unsigned int offset;
+        unsigned int size;
+        unsigned int disable_adr_send : 1;
+        unsigned int pixel_profile : 1;
+};
+
+#define PL_PAR_IOCTL_BUF_SIZE \
+        _IOR(PL_PAR_IOCTL_MAGIC, 0x02, unsigned int)
+#define PL_PAR_IOCTL_FLUSH \
+        _IOW(PL_PAR_IOCTL_MAGIC, 0x03, struct pl_par_ioctl_flush)
+
+/*
+ * Submission/completion rings, mapped at PL_PAR_RING_MMAP_OFFSET.
+ *
+ * Userspace fills sqes[sq_tail % PL_PAR_RING_ENTRIES] and advances sq_tail,
+ * the kernel advances sq_head when it picks up an entry. Completions are
+ * posted to cqes[cq_tail % PL_PAR_RING_ENTRIES], userspace advances cq_head
+ * after consuming them. While PL_PAR_RING_NEED_WAKEUP is set in flags the
+ * kernel worker is idle and has to be kicked with PL_PAR_IOCTL_RING_ENTER.
+ * The data of a submission lives in the mmap'ed image buffer.
+ */
+#define PL_PAR_RING_ENTRIES             256
+#define PL_PAR_RING_MMAP_OFFSET         0x10000000UL
+#define PL_PAR_RING_NEED_WAKEUP         (1U << 0)
+
+enum pl_par_sqe_flags {
+        PL_PAR_SQE_NO_ADR = 1 << 0,
+        PL_PAR_SQE_PIXEL = 1 << 1,
+};
+
+struct pl_par_sqe {
+        __u64 user_data;
+        __u32 offset;
+        __u32 size;
+        __u16 adr;
+        __u8 rd_wr;
+        __u8 flags;
+        __u32 reserved;
+};
+
+/* res holds the transferred bytes or a negative error code */
+struct pl_par_cqe {
+        __u64 user_data;
+        __u64 start_ns;
+        __u64 end_ns;
+        __s32 res;
+        __u32 reserved;
 };
 
+struct pl_par_ring {
+        __u32 sq_head;
+        __u32 sq_tail;
+        __u32 cq_head;
+        __u32 cq_tail;
+        __u32 flags;
+        __u32 entries;
+        struct pl_par_sqe sqes[PL_PAR_RING_ENTRIES];
+        struct pl_par_cqe cqes[PL_PAR_RING_ENTRIES];
+};
+
+/* kicks the ring worker and waits for arg completions (0 = don't wait) */
+#define PL_PAR_IOCTL_RING_ENTER \
+        _IO(PL_PAR_IOCTL_MAGIC, 0x04)
+
+/*
+ * Searches the fastest timings of a profile (0 = register, 1 = pixel). Test
+ * patterns of words 16-bit words are written after wr_adr and read back after
+ * sending rd_adr, so both should address the same scratch register or RAM
+ * window. The cycle counts found are raised by margin percent, programmed and
+ * returned in the remaining fields. The pixel profile only has write timings,
+ * its patterns are read back with the register profile.
+ */
+struct pl_par_ioctl_calibrate {
+        unsigned short wr_adr;
+        unsigned short rd_adr;
+        unsigned int words;
+        unsigned int margin;
+        unsigned int profile;
+        unsigned int clk_div;
+        unsigned char w_su;
+        unsigned char w_strobe;
+        unsigned char w_hold;
+        unsigned char r_su;
+        unsigned char r_strobe;
+        unsigned char r_hold;
+        unsigned char cs_delay;
+};
+
+#define PL_PAR_IOCTL_CALIBRATE \
+        _IOWR(PL_PAR_IOCTL_MAGIC, 0x05, struct pl_par_ioctl_calibrate)
+
+/*
+ * Priority class of a file descriptor, passed as the ioctl argument. The bus 
+ * is granted to waiting interactive transactions first. Writes of bulk 
+ * clients are split at chunk boundaries to let waiting transactions in. If
+ * that happens, the address is sent again before the next chunk, so it has to
+ * select a port which continues the data stream. Writes without an address 
+ * (0xFFFF) are never split.
+ */
+enum pl_par_prio {
+        PL_PAR_PRIO_INTERACTIVE = 0,
+        PL_PAR_PRIO_BULK = 1,
+};
+
+#define PL_PAR_IOCTL_PRIO \
+        _IO(PL_PAR_IOCTL_MAGIC, 0x06)
+
+/*
+ * Display lists. A list is uploaded once and executed in the kernel as often
+ * as needed. Its ops refer to the inline data words of the list:
+ *
+ * PL_PAR_DL_ADR:       sends adr.
+ * PL_PAR_DL_DATA:      sends count data words starting at word arg.
+ * PL_PAR_DL_BUF:       sends count words of the image buffer starting at word
+ *                      arg.
+ * PL_PAR_DL_WAIT_HRDY: waits until the device is ready.
+ * PL_PAR_DL_DELAY:     sleeps for arg us.
+ * PL_PAR_DL_POLL:      sends adr and reads a word until (word & mask) equals
+ *                      value, for at most arg ms.
+ *
+ * Before each run the data words listed in patches are replaced by the
+ * parameters passed to PL_PAR_IOCTL_DL_EXEC, e.g. the coordinates of an area.
+ * Lists belong to the file descriptor they were created with.
+ */
+#define PL_PAR_DL_MAX_OPS               1024
+#define PL_PAR_DL_MAX_PARAMS            256
+
+enum pl_par_dl_opcode {
+        PL_PAR_DL_ADR = 0,
+        PL_PAR_DL_DATA = 1,
+        PL_PAR_DL_BUF = 2,
+        PL_PAR_DL_WAIT_HRDY = 3,
+        PL_PAR_DL_DELAY = 4,
+        PL_PAR_DL_POLL = 5,
+};
+
+struct pl_par_dl_op {
+        __u16 op;
+        __u16 adr;
+        __u32 arg;
+        __u32 count;
+        __u16 mask;
+        __u16 value;
+};
+
+/* data word word is replaced by parameter param */
+struct pl_par_dl_patch {
+        __u32 word;
+        __u32 param;
+};
+
+/* handle is returned by PL_PAR_IOCTL_DL_CREATE */
+struct pl_par_ioctl_dl {
+        struct pl_par_dl_op *ops;
+        __u32 nops;
+        __u16 *data;
+        __u32 ndata;
+        struct pl_par_dl_patch *patches;
+        __u32 npatches;
+        __u32 handle;
+};
+
+struct pl_par_ioctl_dl_exec {
+        __u32 handle;
+        __u32 nparams;
+        __u16 *params;
+};
+
+#define PL_PAR_IOCTL_DL_CREATE \
+        _IOWR(PL_PAR_IOCTL_MAGIC, 0x07, struct pl_par_ioctl_dl)
+#define PL_PAR_IOCTL_DL_EXEC \
+        _IOW(PL_PAR_IOCTL_MAGIC, 0x08, struct pl_par_ioctl_dl_exec)
+/* the argument is the handle */
+#define PL_PAR_IOCTL_DL_DESTROY \
+        _IO(PL_PAR_IOCTL_MAGIC, 0x09)
+
+/*
+ * Pixel packing. With a depth of 4, 2 or 1 bpp set, the data following the
+ * address of each write() are taken as 8bpp pixels, one per byte, and sent
+ * packed into 16-bit words. Each pixel keeps its most significant bits, the
+ * first pixel of a word ends up in its least significant bits. The pixels
+ * have to fill whole words. A depth of 8 sends the data as they are again.
+ */
+#define PL_PAR_IOCTL_PACK \
+        _IO(PL_PAR_IOCTL_MAGIC, 0x0A)
+
+/*
+ * Dirty regions. Describes an image of width x height pixels of bpp bits at
+ * offset of the image buffer, stride bytes per line. The image is split into
+ * tiles of tile x tile pixels (0 selects 32). PL_PAR_IOCTL_DIRTY_FLUSH sends
+ * the rectangles made up of the tiles which changed since the last flush. For
+ * each rectangle the display list area_dl (0 for none) is run with the 
+ * parameters x, y, w and h in pixels, followed by adr and the pixel data, line
+ * by line. A new setup sends the whole image with the next flush.
+ */
+struct pl_par_ioctl_dirty_setup {
+        __u32 offset;
+        __u32 width;
+        __u32 height;
+        __u32 stride;
+        __u32 bpp;
+        __u32 tile;
+        __u32 area_dl;
+        __u16 adr;
+        __u16 pixel_profile;
+};
+
+#define PL_PAR_DIRTY_FULL               (1 << 0)
+
+#define PL_PAR_IOCTL_DIRTY_SETUP \
+        _IOW(PL_PAR_IOCTL_MAGIC, 0x0B, struct pl_par_ioctl_dirty_setup)
+/* the argument are PL_PAR_DIRTY_* flags, returns the number of rectangles */
+#define PL_PAR_IOCTL_DIRTY_FLUSH \
+        _IO(PL_PAR_IOCTL_MAGIC, 0x0C)
+
+/*
+ * Positional mode, enabled with a non-zero argument. The file offset of 
+ * pread()/pwrite() is the address, which is sent along with the data in one
+ * transfer. All of the written data are data words. An offset of 0xFFFF sends
+ * no address. read()/write() use offset 0.
+ */
+#define PL_PAR_IOCTL_POSITIONAL \
+        _IO(PL_PAR_IOCTL_MAGIC, 0x0D)
+
 #endif /* V1_0 */
 
 #endif /* PL_PAR_IOCTL_H */
\ No newline at end of file
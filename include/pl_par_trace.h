@@ -0,0 +1,199 @@
+// SPDX-License-Identifier: GPL-3.0
+/*
+ * pl_par_trace.h - trace events of the parallel bus
+ *
+ * Copyright (c) 2021 PL Germany
+ *
+ * Authors
+ *      Lars Görner <lars.goerner@plasticlogic.com>
+ *
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM pl_par
+
+#if !defined(PL_PAR_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define PL_PAR_TRACE_H
+
+#include <linux/tracepoint.h>
+#include <linux/types.h>
+#include <ctrl/am335x_ctrl.h>
+
+/* HRDY wait phases of enum hrdy_phase */
+TRACE_DEFINE_ENUM(HRDY_PRE_ADR);
+TRACE_DEFINE_ENUM(HRDY_PRE_DATA);
+TRACE_DEFINE_ENUM(HRDY_WORD);
+
+#define show_hrdy_phase(phase)                                          \
+        __print_symbolic(phase,                                         \
+                         { HRDY_PRE_ADR, "pre_adr" },                   \
+                         { HRDY_PRE_DATA, "pre_data" },                 \
+                         { HRDY_WORD, "word" })
+
+////////////////////////////////////////////////////////////////////////////////
+// Transfers
+
+DECLARE_EVENT_CLASS(pl_par_xfer_enter,
+
+        TP_PROTO(size_t size),
+
+        TP_ARGS(size),
+
+        TP_STRUCT__entry(
+                __field(size_t, size)
+        ),
+
+        TP_fast_assign(
+                __entry->size = size;
+        ),
+
+        TP_printk("size=%zu", __entry->size)
+);
+
+DEFINE_EVENT(pl_par_xfer_enter, pl_par_write_enter,
+        TP_PROTO(size_t size),
+        TP_ARGS(size)
+);
+
+DEFINE_EVENT(pl_par_xfer_enter, pl_par_read_enter,
+        TP_PROTO(size_t size),
+        TP_ARGS(size)
+);
+
+DECLARE_EVENT_CLASS(pl_par_xfer_exit,
+
+        TP_PROTO(size_t size, ssize_t ret),
+
+        TP_ARGS(size, ret),
+
+        TP_STRUCT__entry(
+                __field(size_t, size)
+                __field(ssize_t, ret)
+        ),
+
+        TP_fast_assign(
+                __entry->size = size;
+                __entry->ret = ret;
+        ),
+
+        TP_printk("size=%zu ret=%zd", __entry->size, __entry->ret)
+);
+
+DEFINE_EVENT(pl_par_xfer_exit, pl_par_write_exit,
+        TP_PROTO(size_t size, ssize_t ret),
+        TP_ARGS(size, ret)
+);
+
+DEFINE_EVENT(pl_par_xfer_exit, pl_par_read_exit,
+        TP_PROTO(size_t size, ssize_t ret),
+        TP_ARGS(size, ret)
+);
+
+////////////////////////////////////////////////////////////////////////////////
+// Bus phases
+
+TRACE_EVENT(pl_par_addr,
+
+        TP_PROTO(unsigned short adr),
+
+        TP_ARGS(adr),
+
+        TP_STRUCT__entry(
+                __field(unsigned short, adr)
+        ),
+
+        TP_fast_assign(
+                __entry->adr = adr;
+        ),
+
+        TP_printk("adr=0x%04x", __entry->adr)
+);
+
+/* Only waits which didn't find HRDY ready right away are traced */
+TRACE_EVENT(pl_par_hrdy_wait,
+
+        TP_PROTO(unsigned int phase, u64 waited_ns, int ret),
+
+        TP_ARGS(phase, waited_ns, ret),
+
+        TP_STRUCT__entry(
+                __field(unsigned int, phase)
+                __field(u64, waited_ns)
+                __field(int, ret)
+        ),
+
+        TP_fast_assign(
+                __entry->phase = phase;
+                __entry->waited_ns = waited_ns;
+                __entry->ret = ret;
+        ),
+
+        TP_printk("phase=%s waited_ns=%llu ret=%d",
+                  show_hrdy_phase(__entry->phase), __entry->waited_ns,
+                  __entry->ret)
+);
+
+TRACE_EVENT(pl_par_dma_start,
+
+        TP_PROTO(size_t words, unsigned int chunks),
+
+        TP_ARGS(words, chunks),
+
+        TP_STRUCT__entry(
+                __field(size_t, words)
+                __field(unsigned int, chunks)
+        ),
+
+        TP_fast_assign(
+                __entry->words = words;
+                __entry->chunks = chunks;
+        ),
+
+        TP_printk("words=%zu chunks=%u", __entry->words, __entry->chunks)
+);
+
+TRACE_EVENT(pl_par_dma_done,
+
+        TP_PROTO(size_t words, int ret),
+
+        TP_ARGS(words, ret),
+
+        TP_STRUCT__entry(
+                __field(size_t, words)
+                __field(int, ret)
+        ),
+
+        TP_fast_assign(
+                __entry->words = words;
+                __entry->ret = ret;
+        ),
+
+        TP_printk("words=%zu ret=%d", __entry->words, __entry->ret)
+);
+
+TRACE_EVENT(pl_par_timeout,
+
+        TP_PROTO(const char *src),
+
+        TP_ARGS(src),
+
+        TP_STRUCT__entry(
+                __string(src, src)
+        ),
+
+        TP_fast_assign(
+                __assign_str(src, src);
+        ),
+
+        TP_printk("src=%s", __get_str(src))
+);
+
+#endif /* PL_PAR_TRACE_H */
+
+/* The header lives outside of include/trace */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE pl_par_trace
+
+#include <trace/define_trace.h>
@@ -23,111 +23,2512 @@
 #include <linux/uaccess.h>
 #include <linux/errno.h>
 #include <linux/err.h>
+#include <linux/mutex.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+#include <linux/wait.h>
+#include <linux/ktime.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/poll.h>
+#include <linux/of.h>
+#include <linux/sizes.h>
+#include <linux/mm.h>
+#include <linux/scatterlist.h>
+#include <linux/debugfs.h>
+#include <linux/idr.h>
+#include <linux/delay.h>
+#include <linux/jiffies.h>
+#include <linux/jhash.h>
+#include <linux/log2.h>
+#include <linux/bitops.h>
+#include <linux/uio.h>
+#ifdef PL_PAR_FB
+#include <linux/fb.h>
+#endif
 
 #include <ctrl/controller.h>
 #include <ctrl/am335x_ctrl.h>
+#include <pl_par_ioctl.h>
+
+#define CREATE_TRACE_POINTS
+#include <pl_par_trace.h>
 
 #define DEVICE_NAME     "parallel"
 #define CLASS_NAME      "pl_par"
 
-static struct cdev *pl_parallel_cdev = NULL;
-static struct controller *ctrl = NULL;
-static dev_t cdev_dev_t = 0;
+#define WRITE_QUEUE_DEPTH       16
+#define POOL_CHUNKS_PROP        "pool-chunks"
+#define POOL_CHUNK_SIZE_PROP    "pool-chunk-size"
+#define POOL_CHUNKS             4
+#define POOL_CHUNK_SIZE         SZ_64K
+#define ZC_THRESHOLD            SZ_256K
+#define NONBLOCK_HRDY_TIMEOUT_MSECS     20
+#define MAX_DEVICES             8
+#define ARB_MAX_BULK_SKIP       8
+#define DL_MAX_DELAY_US         USEC_PER_SEC
+#define DL_MAX_POLL_MS          (10 * MSEC_PER_SEC)
+#define DL_POLL_US              100
+#define PACK_BLOCK              256
+#define DIRTY_TILE              32
+#define DIRTY_TILE_MAX          256
+#define DIRTY_AREA_PARAMS       4
+#define HRDY_INTERVAL_PROP      "hrdy-interval"
+#define READ_HRDY_INTERVAL_PROP "read-hrdy-interval"
+#define FB_WIDTH_PROP           "fb-width"
+#define FB_HEIGHT_PROP          "fb-height"
+#define FB_ADR_PROP             "fb-adr"
+#define FB_BUS_BPP_PROP         "fb-bus-bpp"
+#define FB_DEFER_MS_PROP        "fb-defer-ms"
+#define FB_AREA_CMD_PROP        "fb-area-cmd"
+#define FB_END_CMD_PROP         "fb-end-cmd"
+#define FB_PIXEL_PROFILE_PROP   "fb-pixel-profile"
+#define FB_DEFER_MS             50
+#define FB_CMD_MAX              16
+
+static struct class pl_parallel_class;
+static dev_t pl_parallel_devt = 0;
+static DEFINE_IDA(pl_parallel_ida);
+static struct dentry *pl_parallel_debugfs = NULL;
+
+struct pl_parallel_pool {
+        spinlock_t lock;
+        wait_queue_head_t wait;
+        unsigned short **chunks;
+        unsigned int count;
+        unsigned int nfree;
+        size_t chunk_size;
+};
+
+/*
+ * Grants the bus to one transaction at a time. Waiting transactions are 
+ * queued per priority class in arrival order. Interactive transactions go
+ * first, but never more than ARB_MAX_BULK_SKIP times in a row while bulk 
+ * transactions are waiting.
+ */
+struct pl_parallel_arb {
+        spinlock_t lock;
+        wait_queue_head_t wait;
+        struct list_head queue[2];
+        unsigned int bulk_skipped;
+        int busy;
+};
+
+struct pl_parallel_waiter {
+        struct list_head list;
+        int granted;
+};
+
+/*
+ * State of one parallel bus, /dev/parallel<id>. The arbiter serializes the
+ * transfers on the controller, holding it is called holding the bus lock.
+ */
+struct pl_parallel_dev {
+        int id;
+        struct controller *ctrl;
+        struct cdev cdev;
+        struct device *dev;
+        struct pl_parallel_arb arb;
+        enum ctrl_profile profile;
+        struct pl_parallel_pool pool;
+        unsigned int zc_threshold;
+        unsigned int pixel_threshold;
+        struct dentry *debugfs;
+#ifdef PL_PAR_FB
+        struct fb_info *fb;
+#endif
+};
+
+struct pl_parallel_pin {
+        struct page **pages;
+        int npages;
+        unsigned int offs;
+        struct sg_table sgt;
+};
+
+struct pl_parallel_wreq {
+        unsigned short *chunk;
+        size_t len;
+};
+
+struct pl_parallel_file {
+        struct pl_parallel_dev *pd;
+        enum pl_par_prio prio;
+        unsigned int pack_bpp;
+        int positional;
+        struct mutex lock;
+        struct pl_par_ring *ring;
+        unsigned int sq_head;
+        unsigned int cq_tail;
+        struct work_struct ring_work;
+        spinlock_t queue_lock;
+        struct pl_parallel_wreq queue[WRITE_QUEUE_DEPTH];
+        unsigned int queue_head;
+        unsigned int queued;
+        int error;
+        struct work_struct write_work;
+        wait_queue_head_t wait;
+        struct idr dls;
+        struct pl_parallel_dirty *dirty;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Profiles
+
+/*
+ * The register profile is the default. Transfers using the pixel profile 
+ * switch back once they are done. The bus lock has to be held.
+ */
+static void pl_parallel_set_profile(struct pl_parallel_dev *pd, 
+                                    enum ctrl_profile profile)
+{
+        struct controller *ctrl = pd->ctrl;
+
+        pd->profile = profile;
+        if(ctrl->set_profile)
+                ctrl->set_profile(ctrl, profile);
+}
+
+// writes of at least pixel_threshold bytes use the pixel profile
+static enum ctrl_profile pl_parallel_write_profile(struct pl_parallel_dev *pd,
+                                                   size_t size)
+{
+        unsigned int threshold = READ_ONCE(pd->pixel_threshold);
+
+        if(threshold && size >= threshold)
+                return CTRL_PROFILE_PIXEL;
+        return CTRL_PROFILE_REG;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Arbiter
+
+static void pl_parallel_arb_init(struct pl_parallel_arb *arb)
+{
+        spin_lock_init(&arb->lock);
+        init_waitqueue_head(&arb->wait);
+        INIT_LIST_HEAD(&arb->queue[PL_PAR_PRIO_INTERACTIVE]);
+        INIT_LIST_HEAD(&arb->queue[PL_PAR_PRIO_BULK]);
+        arb->bulk_skipped = 0;
+        arb->busy = 0;
+}
+
+/* Hands the bus to the next waiter. The arbiter lock has to be held. */
+static void pl_parallel_arb_grant(struct pl_parallel_arb *arb)
+{
+        struct list_head *inter = &arb->queue[PL_PAR_PRIO_INTERACTIVE];
+        struct list_head *bulk = &arb->queue[PL_PAR_PRIO_BULK];
+        struct pl_parallel_waiter *w;
+
+        if(!list_empty(bulk) && (list_empty(inter) || 
+                                 arb->bulk_skipped >= ARB_MAX_BULK_SKIP)) {
+                w = list_first_entry(bulk, struct pl_parallel_waiter, list);
+                arb->bulk_skipped = 0;
+        } else if(!list_empty(inter)) {
+                w = list_first_entry(inter, struct pl_parallel_waiter, list);
+                if(!list_empty(bulk))
+                        arb->bulk_skipped++;
+        } else {
+                arb->busy = 0;
+                return;
+        }
+
+        list_del(&w->list);
+        smp_store_release(&w->granted, 1);
+        wake_up_all(&arb->wait);
+}
+
+static int pl_parallel_bus_wait(struct pl_parallel_dev *pd, 
+                                enum pl_par_prio prio, int intr)
+{
+        struct pl_parallel_arb *arb = &pd->arb;
+        struct pl_parallel_waiter w = { .granted = 0 };
+        int ret = 0;
+
+        spin_lock(&arb->lock);
+        if(!arb->busy) {
+                arb->busy = 1;
+                spin_unlock(&arb->lock);
+                return 0;
+        }
+        list_add_tail(&w.list, &arb->queue[prio]);
+        spin_unlock(&arb->lock);
+
+        if(intr)
+                ret = wait_event_interruptible(arb->wait, 
+                                               smp_load_acquire(&w.granted));
+        else
+                wait_event(arb->wait, smp_load_acquire(&w.granted));
+        if(!ret)
+                return 0;
+
+        spin_lock(&arb->lock);
+        if(w.granted)
+                // granted while being interrupted, pass the bus on
+                pl_parallel_arb_grant(arb);
+        else
+                list_del(&w.list);
+        spin_unlock(&arb->lock);
+        return -ERESTARTSYS;
+}
+
+static int pl_parallel_bus_lock(struct pl_parallel_dev *pd, 
+                                enum pl_par_prio prio)
+{
+        return pl_parallel_bus_wait(pd, prio, 1);
+}
+
+static void pl_parallel_bus_unlock(struct pl_parallel_dev *pd)
+{
+        spin_lock(&pd->arb.lock);
+        pl_parallel_arb_grant(&pd->arb);
+        spin_unlock(&pd->arb.lock);
+}
+
+// bus lock hooks of the controller, e.g. for timing changes through sysfs
+static int pl_parallel_ctrl_bus_lock(void *bus_data)
+{
+        return pl_parallel_bus_lock(bus_data, PL_PAR_PRIO_INTERACTIVE);
+}
+
+static void pl_parallel_ctrl_bus_unlock(void *bus_data)
+{
+        pl_parallel_bus_unlock(bus_data);
+}
+
+/*
+ * Lets the waiting transactions use the bus at a chunk boundary of a bulk 
+ * transfer. Returns 1 if the bus was handed over, the caller has to send its
+ * address again then. The profile in use is restored.
+ */
+static int pl_parallel_bus_yield(struct pl_parallel_dev *pd, 
+                                 enum pl_par_prio prio)
+{
+        struct pl_parallel_arb *arb = &pd->arb;
+        enum ctrl_profile profile = pd->profile;
+        int waiting;
+
+        if(prio != PL_PAR_PRIO_BULK)
+                return 0;
+
+        spin_lock(&arb->lock);
+        waiting = !list_empty(&arb->queue[PL_PAR_PRIO_INTERACTIVE]) ||
+                  !list_empty(&arb->queue[PL_PAR_PRIO_BULK]);
+        spin_unlock(&arb->lock);
+        if(!waiting)
+                return 0;
+
+        pl_parallel_set_profile(pd, CTRL_PROFILE_REG);
+        pl_parallel_bus_unlock(pd);
+        pl_parallel_bus_wait(pd, prio, 0);
+        pl_parallel_set_profile(pd, profile);
+        return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Pixel packing
+
+static __always_inline void pl_parallel_pack(unsigned short *dst, 
+                                             const u8 *src, size_t len, 
+                                             const unsigned int bpp)
+{
+        const unsigned int ppw = 16 / bpp;
+        unsigned short word;
+        unsigned int i;
+
+        while(len--) {
+                word = 0;
+                for(i = 0; i < ppw; i++)
+                        word |= (src[i] >> (8 - bpp)) << (i * bpp);
+                *dst++ = word;
+                src += ppw;
+        }
+}
+
+// constant depths let the compiler unroll the inner loop
+static void pl_parallel_pack_words(unsigned short *dst, const u8 *src, 
+                                   size_t len, unsigned int bpp)
+{
+        switch(bpp) {
+        case 4:
+                pl_parallel_pack(dst, src, len, 4);
+                break;
+        case 2:
+                pl_parallel_pack(dst, src, len, 2);
+                break;
+        default:
+                pl_parallel_pack(dst, src, len, 1);
+                break;
+        }
+}
+
+/*
+ * Packs the 8bpp pixels in user memory into len words of bpp pixels. The 
+ * pixels are copied in blocks which stay in the cache, so the packing is 
+ * done along with the copy instead of in a pass of its own.
+ */
+static int pl_parallel_pack_user(unsigned short *dst, struct iov_iter *from,
+                                 size_t len, unsigned int bpp)
+{
+        u8 block[PACK_BLOCK];
+        size_t n, ppw = 16 / bpp, max = PACK_BLOCK / ppw;
+
+        while(len) {
+                n = min(len, max);
+                if(copy_from_iter(block, n * ppw, from) != n * ppw)
+                        return -EFAULT;
+
+                pl_parallel_pack_words(dst, block, n, bpp);
+                dst += n;
+                len -= n;
+        }
+
+        return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Pool
+
+/*
+ * Bounce buffers for read() and write(). All chunks are allocated at probe, 
+ * transfers of any length are streamed through a single chunk.
+ */
+static int pl_parallel_pool_init(struct pl_parallel_dev *pd, 
+                                 struct device *dev)
+{
+        u32 count, chunk_size;
+        unsigned int i;
+
+        if(of_property_read_u32(dev->of_node, POOL_CHUNKS_PROP, &count))
+                count = POOL_CHUNKS;
+        if(of_property_read_u32(dev->of_node, POOL_CHUNK_SIZE_PROP, 
+                                &chunk_size))
+                chunk_size = POOL_CHUNK_SIZE;
+
+        if(!count || chunk_size < PAGE_SIZE)
+                return -EINVAL;
+
+        spin_lock_init(&pd->pool.lock);
+        init_waitqueue_head(&pd->pool.wait);
+        pd->pool.chunk_size = PAGE_ALIGN(chunk_size);
+        pd->pool.count = 0;
+
+        pd->pool.chunks = kcalloc(count, sizeof(*pd->pool.chunks), GFP_KERNEL);
+        if(!pd->pool.chunks)
+                return -ENOMEM;
+
+        for(i = 0; i < count; i++) {
+                pd->pool.chunks[i] = kmalloc(pd->pool.chunk_size, GFP_KERNEL);
+                if(!pd->pool.chunks[i])
+                        break;
+                pd->pool.count++;
+        }
+
+        if(!pd->pool.count) {
+                kfree(pd->pool.chunks);
+                return -ENOMEM;
+        }
+
+        if(pd->pool.count < count)
+                dev_warn(dev, "Only %u of %u pool chunks allocated.\n",
+                         pd->pool.count, count);
+
+        pd->pool.nfree = pd->pool.count;
+        return 0;
+}
+
+static void pl_parallel_pool_destroy(struct pl_parallel_dev *pd)
+{
+        unsigned int i;
+
+        for(i = 0; i < pd->pool.count; i++)
+                kfree(pd->pool.chunks[i]);
+        kfree(pd->pool.chunks);
+}
+
+// returns NULL if no chunk is free
+static unsigned short *pl_parallel_pool_tryget(struct pl_parallel_dev *pd)
+{
+        unsigned short *chunk = NULL;
+
+        spin_lock(&pd->pool.lock);
+        if(pd->pool.nfree)
+                chunk = pd->pool.chunks[--pd->pool.nfree];
+        spin_unlock(&pd->pool.lock);
+
+        return chunk;
+}
+
+static unsigned short *pl_parallel_pool_get(struct pl_parallel_dev *pd)
+{
+        unsigned short *chunk;
+
+        do {
+                if(wait_event_interruptible(pd->pool.wait, READ_ONCE(pd->pool.nfree)))
+                        return ERR_PTR(-ERESTARTSYS);
+
+                chunk = pl_parallel_pool_tryget(pd);
+        } while(!chunk);
+
+        return chunk;
+}
+
+static void pl_parallel_pool_put(struct pl_parallel_dev *pd, 
+                                 unsigned short *chunk)
+{
+        spin_lock(&pd->pool.lock);
+        pd->pool.chunks[pd->pool.nfree++] = chunk;
+        spin_unlock(&pd->pool.lock);
+        wake_up_interruptible(&pd->pool.wait);
+}
+
+/*
+ * Sends adr followed by len words from user memory, chunk by chunk. The 
+ * address slot sits in front of the data, so the data stays 32-bit aligned.
+ * With pack set the user data are 8bpp pixels which are packed into words of
+ * pack bpp pixels on the way. The bus lock has to be held, bulk transfers 
+ * hand it over between chunks.
+ */
+static int pl_parallel_write_user(struct pl_parallel_dev *pd, 
+                                  enum pl_par_prio prio, unsigned short *chunk,
+                                  unsigned short adr, struct iov_iter *from,
+                                  size_t len, unsigned int pack)
+{
+        struct controller *ctrl = pd->ctrl;
+        unsigned short *buf = &chunk[1];
+        size_t n, max = pd->pool.chunk_size / sizeof(*chunk) - 2;
+        ssize_t ret;
+
+        buf[0] = adr;
+        do {
+                n = min(len, max);
+                if(pack) {
+                        ret = pl_parallel_pack_user(&buf[1], from, n, pack);
+                        if(ret)
+                                return ret;
+                } else if(copy_from_iter(&buf[1], n * sizeof(*buf), from) != 
+                          n * sizeof(*buf)) {
+                        return -EFAULT;
+                }
+
+                ret = ctrl->write(ctrl, buf, n + 1);
+                if(ret < 0)
+                        return ret;
+
+                len -= n;
+                // without an address the next chunk could not be resumed
+                buf[0] = __UINT16_MAX__;
+                if(len && adr != __UINT16_MAX__ && 
+                   pl_parallel_bus_yield(pd, prio))
+                        buf[0] = adr;
+        } while(len);
+
+        return 0;
+}
+
+/*
+ * Reads len words into user memory, chunk by chunk. The bus lock has to be
+ * held.
+ */
+static int pl_parallel_read_user(struct pl_parallel_dev *pd, 
+                                 unsigned short *chunk, struct iov_iter *to, 
+                                 size_t len)
+{
+        struct controller *ctrl = pd->ctrl;
+        size_t n, max = pd->pool.chunk_size / sizeof(*chunk);
+        int first = 1;
+        ssize_t ret;
+
+        while(len) {
+                n = min(len, max);
+                if(first)
+                        ret = ctrl->read(ctrl, chunk, n);
+                else
+                        ret = ctrl->read_cont(ctrl, chunk, n);
+                if(ret < 0)
+                        return ret;
+
+                if(copy_to_iter(chunk, n * sizeof(*chunk), to) != 
+                   n * sizeof(*chunk))
+                        return -EFAULT;
+
+                len -= n;
+                first = 0;
+        }
+
+        return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Zero copy
+
+/*
+ * Large transfers skip the pool. The user pages are pinned and handed to the 
+ * controller as a scatter list. The buffer has to be 16-bit aligned.
+ */
+static int pl_parallel_use_zc(struct pl_parallel_dev *pd, 
+                              const void __user *data, size_t size)
+{
+        unsigned int threshold = READ_ONCE(pd->zc_threshold);
+
+        return data && threshold && size >= threshold && 
+               IS_ALIGNED((unsigned long)data, sizeof(short));
+}
+
+// only iterators over a single user buffer can be pinned
+static void __user *pl_parallel_iter_buf(struct iov_iter *iter)
+{
+        if(!iter_is_iovec(iter) || iter->nr_segs != 1)
+                return NULL;
+
+        return iter->iov->iov_base + iter->iov_offset;
+}
+
+static int pl_parallel_pin_user(struct pl_parallel_pin *pin, 
+                                unsigned long uaddr, size_t size, int write)
+{
+        unsigned int offs = offset_in_page(uaddr);
+        int ret;
+
+        pin->offs = offs;
+        pin->npages = DIV_ROUND_UP(offs + size, PAGE_SIZE);
+        pin->pages = kvmalloc_array(pin->npages, sizeof(*pin->pages), 
+                                    GFP_KERNEL);
+        if(!pin->pages)
+                return -ENOMEM;
+
+        ret = get_user_pages_fast(uaddr & PAGE_MASK, pin->npages, 
+                                  write ? FOLL_WRITE : 0, pin->pages);
+        if(ret < pin->npages) {
+                pin->npages = max(ret, 0);
+                ret = (ret < 0) ? ret : -EFAULT;
+                goto pin_fail;
+        }
+
+        ret = sg_alloc_table_from_pages(&pin->sgt, pin->pages, pin->npages, 
+                                        offs, size, GFP_KERNEL);
+        if(ret)
+                goto pin_fail;
+
+        return 0;
+
+pin_fail:
+        while(pin->npages)
+                put_page(pin->pages[--pin->npages]);
+        kvfree(pin->pages);
+        return ret;
+}
+
+static void pl_parallel_unpin_user(struct pl_parallel_pin *pin, int dirty)
+{
+        int i;
+
+        sg_free_table(&pin->sgt);
+        for(i = 0; i < pin->npages; i++) {
+                if(dirty)
+                        set_page_dirty_lock(pin->pages[i]);
+                put_page(pin->pages[i]);
+        }
+        kvfree(pin->pages);
+}
+
+/*
+ * Sends a pinned buffer chunk by chunk, each chunk through its own scatter 
+ * list. The bus lock has to be held, it is handed over between the chunks.
+ */
+static int pl_parallel_write_zc_bulk(struct pl_parallel_dev *pd, 
+                                     struct pl_parallel_pin *pin, 
+                                     unsigned short adr, size_t len)
+{
+        struct controller *ctrl = pd->ctrl;
+        size_t n, pos = pin->offs, max = pd->pool.chunk_size / sizeof(short);
+        unsigned short resend = adr;
+        unsigned int offs, npages;
+        struct sg_table sgt;
+        ssize_t ret;
+
+        for(;;) {
+                n = min(len, max);
+                offs = offset_in_page(pos);
+                npages = DIV_ROUND_UP(offs + n * sizeof(short), PAGE_SIZE);
+                ret = sg_alloc_table_from_pages(&sgt, 
+                                                &pin->pages[pos >> PAGE_SHIFT],
+                                                npages, offs, 
+                                                n * sizeof(short), GFP_KERNEL);
+                if(ret)
+                        return ret;
+
+                ret = ctrl->write_sg(ctrl, adr, &sgt, n);
+                sg_free_table(&sgt);
+                if(ret < 0)
+                        return ret;
+
+                len -= n;
+                if(!len)
+                        return 0;
+
+                pos += n * sizeof(short);
+                adr = __UINT16_MAX__;
+                if(resend != __UINT16_MAX__ && 
+                   pl_parallel_bus_yield(pd, PL_PAR_PRIO_BULK))
+                        adr = resend;
+        }
+}
+
+static int pl_parallel_write_zc(struct pl_parallel_dev *pd, 
+                                enum pl_par_prio prio, unsigned short adr,
+                                const void __user *data, size_t len, 
+                                enum ctrl_profile profile)
+{
+        struct controller *ctrl = pd->ctrl;
+        struct pl_parallel_pin pin;
+        ssize_t ret;
+
+        ret = pl_parallel_pin_user(&pin, (unsigned long)data, 
+                                   len * sizeof(short), 0);
+        if(ret)
+                return ret;
+
+        ret = pl_parallel_bus_lock(pd, prio);
+        if(ret)
+                goto err;
+        pl_parallel_set_profile(pd, profile);
+        if(prio == PL_PAR_PRIO_BULK)
+                ret = pl_parallel_write_zc_bulk(pd, &pin, adr, len);
+        else
+                ret = ctrl->write_sg(ctrl, adr, &pin.sgt, len);
+        pl_parallel_set_profile(pd, CTRL_PROFILE_REG);
+        pl_parallel_bus_unlock(pd);
+
+err:
+        pl_parallel_unpin_user(&pin, 0);
+        return (ret < 0) ? ret : 0;
+}
+
+static int pl_parallel_read_zc(struct pl_parallel_dev *pd, 
+                               enum pl_par_prio prio, unsigned short adr,
+                               void __user *data, size_t len)
+{
+        struct controller *ctrl = pd->ctrl;
+        struct pl_parallel_pin pin;
+        ssize_t ret = 0;
+
+        ret = pl_parallel_pin_user(&pin, (unsigned long)data, 
+                                   len * sizeof(short), 1);
+        if(ret)
+                return ret;
+
+        ret = pl_parallel_bus_lock(pd, prio);
+        if(ret)
+                goto err;
+        if(adr != __UINT16_MAX__)
+                ret = ctrl->write(ctrl, &adr, 1);
+        if(ret >= 0)
+                ret = ctrl->read_sg(ctrl, &pin.sgt, len);
+        pl_parallel_bus_unlock(pd);
+
+err:
+        pl_parallel_unpin_user(&pin, ret >= 0);
+        return (ret < 0) ? ret : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Image buffer
+
+/*
+ * Sends len words of the image buffer starting at word offset. Bulk transfers
+ * are split into pool chunk sized pieces. The bus lock has to be held.
+ */
+static ssize_t pl_parallel_write_buf(struct pl_parallel_dev *pd, 
+                                     enum pl_par_prio prio, unsigned short adr,
+                                     size_t offset, size_t len)
+{
+        struct controller *ctrl = pd->ctrl;
+        size_t n, max = len;
+        unsigned short resend = adr;
+        ssize_t ret;
+
+        if(prio == PL_PAR_PRIO_BULK)
+                max = pd->pool.chunk_size / sizeof(short);
+
+        do {
+                n = min(len, max);
+                ret = ctrl->write_buf(ctrl, adr, offset, n);
+                if(ret < 0)
+                        return ret;
+
+                offset += n;
+                len -= n;
+                adr = __UINT16_MAX__;
+                if(len && resend != __UINT16_MAX__ && 
+                   pl_parallel_bus_yield(pd, prio))
+                        adr = resend;
+        } while(len);
+
+        return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Ring
+
+static int pl_parallel_ring_exec(struct pl_parallel_dev *pd, 
+                                 enum pl_par_prio prio, struct pl_par_sqe *sqe)
+{
+        struct controller *ctrl = pd->ctrl;
+        unsigned short adr;
+        ssize_t ret = 0;
+
+        if(!ctrl->write_buf || !ctrl->buf_size)
+                return -ENODEV;
+
+        if((sqe->offset | sqe->size) & 1)
+                return -EINVAL;
+
+        if(sqe->offset > ctrl->buf_size || 
+           sqe->size > ctrl->buf_size - sqe->offset)
+                return -EINVAL;
+
+        adr = (sqe->flags & PL_PAR_SQE_NO_ADR) ? __UINT16_MAX__ : sqe->adr;
+
+        pl_parallel_bus_wait(pd, prio, 0);
+        switch(sqe->rd_wr) {
+        case PL_PAR_WRITE:
+                if(sqe->flags & PL_PAR_SQE_PIXEL)
+                        pl_parallel_set_profile(pd, CTRL_PROFILE_PIXEL);
+                ret = pl_parallel_write_buf(pd, prio, adr, sqe->offset / 2, 
+                                            sqe->size / 2);
+                pl_parallel_set_profile(pd, CTRL_PROFILE_REG);
+                break;
+        case PL_PAR_READ:
+                if(adr != __UINT16_MAX__)
+                        ret = ctrl->write(ctrl, &adr, 1);
+                if(ret >= 0 && sqe->size)
+                        ret = ctrl->read(ctrl, (unsigned short *)ctrl->buf + 
+                                         sqe->offset / 2, sqe->size / 2);
+                break;
+        default:
+                ret = -EINVAL;
+                break;
+        }
+        pl_parallel_bus_unlock(pd);
+
+        return (ret < 0) ? ret : sqe->size;
+}
+
+static inline int pl_parallel_ring_idle(struct pl_parallel_file *pf)
+{
+        struct pl_par_ring *ring = pf->ring;
+
+        return smp_load_acquire(&ring->sq_tail) == pf->sq_head ||
+               pf->cq_tail - READ_ONCE(ring->cq_head) >= PL_PAR_RING_ENTRIES;
+}
+
+/*
+ * Drains the submission ring onto the controller. The ring indices in the 
+ * shared page are only published, the worker keeps its own copies.
+ */
+static void pl_parallel_ring_work(struct work_struct *work)
+{
+        struct pl_parallel_file *pf = container_of(work, 
+                                                   struct pl_parallel_file, 
+                                                   ring_work);
+        struct pl_par_ring *ring = pf->ring;
+        struct pl_par_sqe sqe;
+        struct pl_par_cqe *cqe;
+
+        WRITE_ONCE(ring->flags, ring->flags & ~PL_PAR_RING_NEED_WAKEUP);
+
+        for(;;) {
+                if(pl_parallel_ring_idle(pf)) {
+                        // going idle, recheck after announcing it
+                        WRITE_ONCE(ring->flags, 
+                                   ring->flags | PL_PAR_RING_NEED_WAKEUP);
+                        smp_mb();
+                        if(pl_parallel_ring_idle(pf))
+                                break;
+                        WRITE_ONCE(ring->flags, 
+                                   ring->flags & ~PL_PAR_RING_NEED_WAKEUP);
+                }
+
+                sqe = ring->sqes[pf->sq_head % PL_PAR_RING_ENTRIES];
+                pf->sq_head++;
+                smp_store_release(&ring->sq_head, pf->sq_head);
+
+                cqe = &ring->cqes[pf->cq_tail % PL_PAR_RING_ENTRIES];
+                cqe->user_data = sqe.user_data;
+                cqe->start_ns = ktime_get_ns();
+                cqe->res = pl_parallel_ring_exec(pf->pd, READ_ONCE(pf->prio),
+                                                 &sqe);
+                cqe->end_ns = ktime_get_ns();
+
+                WRITE_ONCE(pf->cq_tail, pf->cq_tail + 1);
+                smp_store_release(&ring->cq_tail, pf->cq_tail);
+                wake_up_interruptible(&pf->wait);
+        }
+}
+
+static int pl_parallel_ring_mmap(struct pl_parallel_file *pf, 
+                                 struct vm_area_struct *vma)
+{
+        size_t size = PAGE_ALIGN(sizeof(struct pl_par_ring));
+        int ret = 0;
+
+        if(vma->vm_end - vma->vm_start > size)
+                return -EINVAL;
+
+        mutex_lock(&pf->lock);
+        if(!pf->ring) {
+                pf->ring = vmalloc_user(size);
+                if(!pf->ring) {
+                        ret = -ENOMEM;
+                        goto out;
+                }
+                pf->ring->entries = PL_PAR_RING_ENTRIES;
+                pf->ring->flags = PL_PAR_RING_NEED_WAKEUP;
+        }
+        ret = remap_vmalloc_range(vma, pf->ring, 0);
+out:
+        mutex_unlock(&pf->lock);
+        return ret;
+}
+
+static long pl_parallel_ioctl_ring_enter(struct pl_parallel_file *pf,
+                                         unsigned int min_complete)
+{
+        struct pl_par_ring *ring = READ_ONCE(pf->ring);
+
+        if(!ring)
+                return -ENXIO;
+
+        queue_work(system_unbound_wq, &pf->ring_work);
+
+        if(!min_complete)
+                return 0;
+
+        min_complete = min_t(unsigned int, min_complete, PL_PAR_RING_ENTRIES);
+        return wait_event_interruptible(pf->wait, 
+                        READ_ONCE(pf->cq_tail) - READ_ONCE(ring->cq_head) >= 
+                        min_complete);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Write queue
+
+/*
+ * Executes the writes queued by non-blocking writers in order. Each request 
+ * holds its address and data in a pool chunk, laid out like in
+ * pl_parallel_write_user(). A request stays on the queue until it is done, 
+ * so an empty queue means that all queued data has been sent.
+ */
+static void pl_parallel_write_work(struct work_struct *work)
+{
+        struct pl_parallel_file *pf = container_of(work, 
+                                                   struct pl_parallel_file,
+                                                   write_work);
+        struct pl_parallel_dev *pd = pf->pd;
+        struct pl_parallel_wreq req;
+        ssize_t ret;
+
+        for(;;) {
+                spin_lock(&pf->queue_lock);
+                if(!pf->queued) {
+                        spin_unlock(&pf->queue_lock);
+                        break;
+                }
+                req = pf->queue[pf->queue_head];
+                spin_unlock(&pf->queue_lock);
+
+                pl_parallel_bus_wait(pd, READ_ONCE(pf->prio), 0);
+                pl_parallel_set_profile(pd, pl_parallel_write_profile(pd,
+                                                req.len * sizeof(short)));
+                ret = pd->ctrl->write(pd->ctrl, &req.chunk[1], req.len);
+                pl_parallel_set_profile(pd, CTRL_PROFILE_REG);
+                pl_parallel_bus_unlock(pd);
+                if(ret < 0)
+                        WRITE_ONCE(pf->error, ret);
+
+                pl_parallel_pool_put(pd, req.chunk);
+
+                spin_lock(&pf->queue_lock);
+                pf->queue_head = (pf->queue_head + 1) % WRITE_QUEUE_DEPTH;
+                pf->queued--;
+                spin_unlock(&pf->queue_lock);
+
+                wake_up_interruptible(&pf->wait);
+        }
+}
+
+// words a queued write can carry, one chunk less the address slots
+static size_t pl_parallel_write_queue_max(struct pl_parallel_dev *pd)
+{
+        return pd->pool.chunk_size / sizeof(short) - 2;
+}
+
+/*
+ * Writes a file may queue. Each of them holds a pool chunk, so one file 
+ * leaves at least one chunk to the others.
+ */
+static unsigned int pl_parallel_write_queue_depth(struct pl_parallel_dev *pd)
+{
+        return clamp(pd->pool.count - 1, 1u, (unsigned int)WRITE_QUEUE_DEPTH);
+}
+
+/*
+ * Queues adr followed by len data words in a pool chunk. Returns -EAGAIN if 
+ * the queue is full or no chunk is free, len must not exceed 
+ * pl_parallel_write_queue_max().
+ */
+static int pl_parallel_write_queued(struct pl_parallel_file *pf, 
+                                   unsigned short adr, struct iov_iter *from,
+                                   size_t len, unsigned int pack)
+{
+        struct pl_parallel_dev *pd = pf->pd;
+        unsigned short *chunk;
+        int ret;
+
+        ret = xchg(&pf->error, 0);
+        if(ret)
+                return ret;
+
+        if(READ_ONCE(pf->queued) >= pl_parallel_write_queue_depth(pd))
+                return -EAGAIN;
+
+        chunk = pl_parallel_pool_tryget(pd);
+        if(!chunk)
+                return -EAGAIN;
+
+        chunk[1] = adr;
+        if(pack)
+                ret = pl_parallel_pack_user(&chunk[2], from, len, pack);
+        else if(copy_from_iter(&chunk[2], len * sizeof(short), from) != 
+                len * sizeof(short))
+                ret = -EFAULT;
+        if(ret)
+                goto put_chunk;
+
+        spin_lock(&pf->queue_lock);
+        if(pf->queued >= pl_parallel_write_queue_depth(pd)) {
+                spin_unlock(&pf->queue_lock);
+                ret = -EAGAIN;
+                goto put_chunk;
+        }
+        pf->queue[(pf->queue_head + pf->queued) % WRITE_QUEUE_DEPTH] = 
+                (struct pl_parallel_wreq) {.chunk = chunk, .len = len + 1};
+        pf->queued++;
+        spin_unlock(&pf->queue_lock);
+
+        queue_work(system_unbound_wq, &pf->write_work);
+        return 0;
+
+put_chunk:
+        pl_parallel_pool_put(pd, chunk);
+        return ret;
+}
+
+/*
+ * Waits until all queued writes are done and returns the first error one of
+ * them may have hit.
+ */
+static int pl_parallel_write_drain(struct pl_parallel_file *pf)
+{
+        if(wait_event_interruptible(pf->wait, !READ_ONCE(pf->queued)))
+                return -ERESTARTSYS;
+
+        return xchg(&pf->error, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Display lists
+
+struct pl_parallel_dl {
+        struct pl_par_dl_op *ops;
+        unsigned int nops;
+        unsigned short *data;
+        unsigned int ndata;
+        struct pl_par_dl_patch *patches;
+        unsigned int npatches;
+        unsigned int nparams;
+};
+
+static void pl_parallel_dl_free(struct pl_parallel_dl *dl)
+{
+        kfree(dl->patches);
+        kfree(dl->data);
+        kfree(dl->ops);
+        kfree(dl);
+}
+
+static int pl_parallel_dl_check(struct pl_parallel_dev *pd, 
+                                struct pl_parallel_dl *dl)
+{
+        struct controller *ctrl = pd->ctrl;
+        struct pl_par_dl_op *op;
+        size_t buf_words = ctrl->buf_size / sizeof(short);
+        unsigned int i;
+
+        for(i = 0; i < dl->nops; i++) {
+                op = &dl->ops[i];
+                switch(op->op) {
+                case PL_PAR_DL_ADR:
+                case PL_PAR_DL_WAIT_HRDY:
+                        break;
+                case PL_PAR_DL_DATA:
+                        if(op->arg > dl->ndata || 
+                           op->count > dl->ndata - op->arg)
+                                return -EINVAL;
+                        break;
+                case PL_PAR_DL_BUF:
+                        if(!ctrl->write_buf || !ctrl->buf_size)
+                                return -ENODEV;
+                        if(op->arg > buf_words || 
+                           op->count > buf_words - op->arg)
+                                return -EINVAL;
+                        break;
+                case PL_PAR_DL_DELAY:
+                        if(op->arg > DL_MAX_DELAY_US)
+                                return -EINVAL;
+                        break;
+                case PL_PAR_DL_POLL:
+                        if(op->arg > DL_MAX_POLL_MS)
+                                return -EINVAL;
+                        break;
+                default:
+                        return -EINVAL;
+                }
+        }
+
+        dl->nparams = 0;
+        for(i = 0; i < dl->npatches; i++) {
+                if(dl->patches[i].word >= dl->ndata || 
+                   dl->patches[i].param >= PL_PAR_DL_MAX_PARAMS)
+                        return -EINVAL;
+                dl->nparams = max(dl->nparams, dl->patches[i].param + 1);
+        }
+
+        return 0;
+}
+
+static void pl_parallel_dl_delay(unsigned int us)
+{
+        if(us < 10)
+                udelay(us);
+        else
+                usleep_range(us, us + us / 8);
+}
+
+static int pl_parallel_dl_poll(struct pl_parallel_dev *pd, 
+                               const struct pl_par_dl_op *op)
+{
+        struct controller *ctrl = pd->ctrl;
+        unsigned long timeout = jiffies + msecs_to_jiffies(op->arg);
+        unsigned short val;
+        ssize_t ret;
+
+        for(;;) {
+                ret = ctrl->write(ctrl, &op->adr, 1);
+                if(ret >= 0)
+                        ret = ctrl->read(ctrl, &val, 1);
+                if(ret < 0)
+                        return ret;
+
+                if((val & op->mask) == op->value)
+                        return 0;
+                if(time_after(jiffies, timeout))
+                        return -ETIMEDOUT;
+
+                usleep_range(DL_POLL_US, 2 * DL_POLL_US);
+        }
+}
+
+// copies the data words of a list behind the address slot and patches them
+static void pl_parallel_dl_load(struct pl_parallel_dl *dl, 
+                                unsigned short *chunk, 
+                                const unsigned short *params)
+{
+        struct pl_par_dl_patch *patch;
+        unsigned int i;
+
+        memcpy(&chunk[1], dl->data, dl->ndata * sizeof(short));
+        for(i = 0; i < dl->npatches; i++) {
+                patch = &dl->patches[i];
+                chunk[1 + patch->word] = params[patch->param];
+        }
+}
+
+/*
+ * Runs the ops of a list. chunk holds the patched data words from word 1 on,
+ * the word in front of a DATA op serves as its address slot. The bus lock has
+ * to be held.
+ */
+static int pl_parallel_dl_run(struct pl_parallel_dev *pd, 
+                              struct pl_parallel_dl *dl, unsigned short *chunk)
+{
+        struct controller *ctrl = pd->ctrl;
+        struct pl_par_dl_op *op;
+        unsigned short *slot, save;
+        unsigned int i;
+        ssize_t ret = 0;
+
+        for(i = 0; i < dl->nops; i++) {
+                op = &dl->ops[i];
+                switch(op->op) {
+                case PL_PAR_DL_ADR:
+                        ret = ctrl->write(ctrl, &op->adr, 1);
+                        break;
+                case PL_PAR_DL_DATA:
+                        if(!op->count)
+                                break;
+                        slot = &chunk[op->arg];
+                        save = *slot;
+                        *slot = __UINT16_MAX__;
+                        ret = ctrl->write(ctrl, slot, op->count + 1);
+                        *slot = save;
+                        break;
+                case PL_PAR_DL_BUF:
+                        ret = ctrl->write_buf(ctrl, __UINT16_MAX__, op->arg, 
+                                              op->count);
+                        break;
+                case PL_PAR_DL_WAIT_HRDY:
+                        if(ctrl->wait_ready)
+                                ret = ctrl->wait_ready(ctrl);
+                        break;
+                case PL_PAR_DL_DELAY:
+                        pl_parallel_dl_delay(op->arg);
+                        break;
+                case PL_PAR_DL_POLL:
+                        ret = pl_parallel_dl_poll(pd, op);
+                        break;
+                }
+                if(ret < 0)
+                        return ret;
+        }
+
+        return 0;
+}
+
+static long pl_parallel_ioctl_dl_create(struct pl_parallel_file *pf, 
+                                        void __user *arg)
+{
+        struct pl_parallel_dev *pd = pf->pd;
+        struct pl_par_ioctl_dl udl;
+        struct pl_parallel_dl *dl;
+        void *p;
+        int ret;
+
+        if(copy_from_user(&udl, arg, sizeof(udl)))
+                return -EFAULT;
+
+        // one data word is needed in front of the data as address slot
+        if(!udl.nops || udl.nops > PL_PAR_DL_MAX_OPS || 
+           udl.ndata >= pd->pool.chunk_size / sizeof(short) || 
+           udl.npatches > udl.ndata)
+                return -EINVAL;
+
+        dl = kzalloc(sizeof(*dl), GFP_KERNEL);
+        if(!dl)
+                return -ENOMEM;
+        dl->nops = udl.nops;
+        dl->ndata = udl.ndata;
+        dl->npatches = udl.npatches;
+
+        p = memdup_user((void __user *)udl.ops, 
+                        udl.nops * sizeof(*dl->ops));
+        if(IS_ERR(p)) {
+                ret = PTR_ERR(p);
+                goto free_dl;
+        }
+        dl->ops = p;
+
+        if(udl.ndata) {
+                p = memdup_user((void __user *)udl.data, 
+                                udl.ndata * sizeof(short));
+                if(IS_ERR(p)) {
+                        ret = PTR_ERR(p);
+                        goto free_dl;
+                }
+                dl->data = p;
+        }
+
+        if(udl.npatches) {
+                p = memdup_user((void __user *)udl.patches, 
+                                udl.npatches * sizeof(*dl->patches));
+                if(IS_ERR(p)) {
+                        ret = PTR_ERR(p);
+                        goto free_dl;
+                }
+                dl->patches = p;
+        }
+
+        ret = pl_parallel_dl_check(pd, dl);
+        if(ret)
+                goto free_dl;
+
+        mutex_lock(&pf->lock);
+        ret = idr_alloc(&pf->dls, dl, 1, 0, GFP_KERNEL);
+        mutex_unlock(&pf->lock);
+        if(ret < 0)
+                goto free_dl;
+
+        if(put_user(ret, &((struct pl_par_ioctl_dl __user *)arg)->handle)) {
+                mutex_lock(&pf->lock);
+                idr_remove(&pf->dls, ret);
+                mutex_unlock(&pf->lock);
+                ret = -EFAULT;
+                goto free_dl;
+        }
+        return 0;
+
+free_dl:
+        pl_parallel_dl_free(dl);
+        return ret;
+}
+
+static long pl_parallel_ioctl_dl_exec(struct pl_parallel_file *pf, 
+                                      enum pl_par_prio prio, void __user *arg)
+{
+        struct pl_parallel_dev *pd = pf->pd;
+        struct pl_par_ioctl_dl_exec exec;
+        struct pl_parallel_dl *dl;
+        unsigned short *params = NULL;
+        unsigned short *chunk;
+        long ret;
+
+        if(copy_from_user(&exec, arg, sizeof(exec)))
+                return -EFAULT;
+
+        if(exec.nparams > PL_PAR_DL_MAX_PARAMS)
+                return -EINVAL;
+
+        if(exec.nparams) {
+                params = memdup_user((void __user *)exec.params, 
+                                     exec.nparams * sizeof(short));
+                if(IS_ERR(params))
+                        return PTR_ERR(params);
+        }
+
+        chunk = pl_parallel_pool_get(pd);
+        if(IS_ERR(chunk)) {
+                ret = PTR_ERR(chunk);
+                goto free_params;
+        }
+
+        // the list can't be destroyed while it runs
+        mutex_lock(&pf->lock);
+        dl = idr_find(&pf->dls, exec.handle);
+        if(!dl) {
+                ret = -ENOENT;
+                goto unlock;
+        }
+        if(exec.nparams < dl->nparams) {
+                ret = -EINVAL;
+                goto unlock;
+        }
+
+        pl_parallel_dl_load(dl, chunk, params);
+
+        ret = pl_parallel_bus_lock(pd, prio);
+        if(ret)
+                goto unlock;
+        ret = pl_parallel_dl_run(pd, dl, chunk);
+        pl_parallel_bus_unlock(pd);
+
+unlock:
+        mutex_unlock(&pf->lock);
+        pl_parallel_pool_put(pd, chunk);
+free_params:
+        kfree(params);
+        return ret;
+}
+
+static long pl_parallel_ioctl_dl_destroy(struct pl_parallel_file *pf, 
+                                         unsigned int handle)
+{
+        struct pl_parallel_dl *dl;
+
+        mutex_lock(&pf->lock);
+        dl = idr_remove(&pf->dls, handle);
+        mutex_unlock(&pf->lock);
+        if(!dl)
+                return -ENOENT;
+
+        pl_parallel_dl_free(dl);
+        return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Dirty regions
+
+// a rectangle of tiles, columns c0 to c1 - 1 from tile row r0 on
+struct pl_parallel_rect {
+        unsigned int c0;
+        unsigned int c1;
+        unsigned int r0;
+};
+
+/*
+ * Shadow of the image last sent by PL_PAR_IOCTL_DIRTY_FLUSH, one hash per 
+ * tile. The shadow is only valid after a flush went through completely.
+ */
+struct pl_parallel_dirty {
+        struct pl_par_ioctl_dirty_setup cfg;
+        unsigned int cols;
+        unsigned int rows;
+        int valid;
+        u32 *hashes;
+        u32 *acc;
+        unsigned long *map;
+        struct pl_parallel_rect *pend;
+        struct pl_parallel_rect *next;
+};
+
+static void pl_parallel_dirty_free(struct pl_parallel_dirty *dirty)
+{
+        if(!dirty)
+                return;
+
+        kfree(dirty->next);
+        kfree(dirty->pend);
+        kvfree(dirty->map);
+        kfree(dirty->acc);
+        kvfree(dirty->hashes);
+        kfree(dirty);
+}
+
+static long pl_parallel_ioctl_dirty_setup(struct pl_parallel_file *pf, 
+                                          void __user *arg)
+{
+        struct controller *ctrl = pf->pd->ctrl;
+        struct pl_par_ioctl_dirty_setup cfg;
+        struct pl_parallel_dirty *dirty, *old;
+        unsigned int tiles;
+        u64 end;
+
+        if(copy_from_user(&cfg, arg, sizeof(cfg)))
+                return -EFAULT;
+
+        if(!ctrl->write_buf || !ctrl->buf_size)
+                return -ENODEV;
+
+        if(!cfg.tile)
+                cfg.tile = DIRTY_TILE;
+
+        if(!cfg.width || !cfg.height || cfg.width > ctrl->buf_size || 
+           cfg.height > ctrl->buf_size || !is_power_of_2(cfg.bpp) || 
+           cfg.bpp > 16 || !is_power_of_2(cfg.tile) || 
+           cfg.tile > DIRTY_TILE_MAX)
+                return -EINVAL;
+
+        // lines and tiles have to start on word boundaries
+        if((cfg.width * cfg.bpp) % 16 || (cfg.tile * cfg.bpp) % 16 || 
+           (cfg.offset | cfg.stride) & 1 || 
+           cfg.stride < cfg.width * cfg.bpp / 8)
+                return -EINVAL;
+
+        end = cfg.offset + (u64)(cfg.height - 1) * cfg.stride + 
+              cfg.width * cfg.bpp / 8;
+        if(end > ctrl->buf_size)
+                return -EINVAL;
+
+        dirty = kzalloc(sizeof(*dirty), GFP_KERNEL);
+        if(!dirty)
+                return -ENOMEM;
+
+        dirty->cfg = cfg;
+        dirty->cols = DIV_ROUND_UP(cfg.width, cfg.tile);
+        dirty->rows = DIV_ROUND_UP(cfg.height, cfg.tile);
+        tiles = dirty->cols * dirty->rows;
+        dirty->hashes = kvcalloc(tiles, sizeof(*dirty->hashes), GFP_KERNEL);
+        dirty->acc = kcalloc(dirty->cols, sizeof(*dirty->acc), GFP_KERNEL);
+        dirty->map = kvcalloc(BITS_TO_LONGS(tiles), sizeof(long), GFP_KERNEL);
+        dirty->pend = kcalloc(dirty->cols, sizeof(*dirty->pend), GFP_KERNEL);
+        dirty->next = kcalloc(dirty->cols, sizeof(*dirty->next), GFP_KERNEL);
+        if(!dirty->hashes || !dirty->acc || !dirty->map || !dirty->pend || 
+           !dirty->next) {
+                pl_parallel_dirty_free(dirty);
+                return -ENOMEM;
+        }
+
+        mutex_lock(&pf->lock);
+        if(cfg.area_dl && !idr_find(&pf->dls, cfg.area_dl)) {
+                mutex_unlock(&pf->lock);
+                pl_parallel_dirty_free(dirty);
+                return -ENOENT;
+        }
+        old = pf->dirty;
+        pf->dirty = dirty;
+        mutex_unlock(&pf->lock);
+
+        pl_parallel_dirty_free(old);
+        return 0;
+}
+
+/*
+ * Hashes the image and marks the tiles whose hash changed since the last 
+ * flush. The lines are hashed in memory order, each tile of a tile row 
+ * accumulating its own hash. Returns the number of marked tiles.
+ */
+static unsigned int pl_parallel_dirty_scan(struct pl_parallel_dirty *dirty, 
+                                           const u8 *img, int full)
+{
+        struct pl_par_ioctl_dirty_setup *cfg = &dirty->cfg;
+        unsigned int line_bytes = cfg->width * cfg->bpp / 8;
+        unsigned int tile_bytes = cfg->tile * cfg->bpp / 8;
+        unsigned int r, c, y, y1, idx, n = 0;
+        const u8 *line;
+
+        img += cfg->offset;
+        for(r = 0; r < dirty->rows; r++) {
+                memset(dirty->acc, 0, dirty->cols * sizeof(*dirty->acc));
+                y1 = min((r + 1) * cfg->tile, cfg->height);
+                for(y = r * cfg->tile; y < y1; y++) {
+                        line = img + y * cfg->stride;
+                        for(c = 0; c < dirty->cols; c++)
+                                dirty->acc[c] = jhash(line + c * tile_bytes,
+                                        min(tile_bytes, 
+                                            line_bytes - c * tile_bytes),
+                                        dirty->acc[c]);
+                }
+
+                for(c = 0; c < dirty->cols; c++) {
+                        idx = r * dirty->cols + c;
+                        if(full || dirty->hashes[idx] != dirty->acc[c]) {
+                                __set_bit(idx, dirty->map);
+                                n++;
+                        } else {
+                                __clear_bit(idx, dirty->map);
+                        }
+                        dirty->hashes[idx] = dirty->acc[c];
+                }
+        }
+
+        return n;
+}
+
+/*
+ * Sends the rectangle rect ending before tile row r1: the area list with the
+ * rectangle in pixels as parameters, then adr and the pixels line by line.
+ */
+static int pl_parallel_dirty_send(struct pl_parallel_dev *pd, 
+                                  enum pl_par_prio prio, 
+                                  struct pl_parallel_dirty *dirty, 
+                                  struct pl_parallel_dl *area, 
+                                  unsigned short *chunk, 
+                                  const struct pl_parallel_rect *rect, 
+                                  unsigned int r1)
+{
+        struct controller *ctrl = pd->ctrl;
+        struct pl_par_ioctl_dirty_setup *cfg = &dirty->cfg;
+        unsigned int x, y, w, h, i;
+        unsigned short adr = cfg->adr;
+        unsigned short params[DIRTY_AREA_PARAMS];
+        size_t offset, words;
+        ssize_t ret = 0;
+
+        x = rect->c0 * cfg->tile;
+        y = rect->r0 * cfg->tile;
+        w = min(rect->c1 * cfg->tile, cfg->width) - x;
+        h = min(r1 * cfg->tile, cfg->height) - y;
+
+        words = w * cfg->bpp / 16;
+        offset = (cfg->offset + y * cfg->stride + x * cfg->bpp / 8) / 2;
+
+        ret = pl_parallel_bus_lock(pd, prio);
+        if(ret)
+                return ret;
+
+        if(area) {
+                params[0] = x;
+                params[1] = y;
+                params[2] = w;
+                params[3] = h;
+                pl_parallel_dl_load(area, chunk, params);
+                ret = pl_parallel_dl_run(pd, area, chunk);
+                if(ret)
+                        goto unlock;
+        }
+
+        if(cfg->pixel_profile)
+                pl_parallel_set_profile(pd, CTRL_PROFILE_PIXEL);
+        if(words * 2 == cfg->stride) {
+                // full lines without padding are contiguous
+                ret = ctrl->write_buf(ctrl, adr, offset, words * h);
+        } else {
+                for(i = 0; i < h && ret >= 0; i++) {
+                        ret = ctrl->write_buf(ctrl, adr, offset, words);
+                        adr = __UINT16_MAX__;
+                        offset += cfg->stride / 2;
+                }
+        }
+        pl_parallel_set_profile(pd, CTRL_PROFILE_REG);
+
+unlock:
+        pl_parallel_bus_unlock(pd);
+        return (ret < 0) ? ret : 0;
+}
+
+/*
+ * Sends the changed tiles of the image as rectangles. Runs of changed tiles 
+ * in a tile row extend the rectangle above them if it spans the same columns.
+ * Returns the number of rectangles sent.
+ */
+static long pl_parallel_ioctl_dirty_flush(struct pl_parallel_file *pf, 
+                                          enum pl_par_prio prio, 
+                                          unsigned long flags)
+{
+        struct pl_parallel_dev *pd = pf->pd;
+        struct pl_parallel_dirty *dirty;
+        struct pl_parallel_dl *area = NULL;
+        struct pl_parallel_rect *pend, *next;
+        unsigned int r, c, c0, i, npend = 0, nnext;
+        unsigned short *chunk;
+        long ret = 0, nrects = 0;
+
+        if(flags & ~PL_PAR_DIRTY_FULL)
+                return -EINVAL;
+
+        chunk = pl_parallel_pool_get(pd);
+        if(IS_ERR(chunk))
+                return PTR_ERR(chunk);
+
+        mutex_lock(&pf->lock);
+        dirty = pf->dirty;
+        if(!dirty) {
+                ret = -ENXIO;
+                goto unlock;
+        }
+
+        if(dirty->cfg.area_dl) {
+                area = idr_find(&pf->dls, dirty->cfg.area_dl);
+                if(!area) {
+                        ret = -ENOENT;
+                        goto unlock;
+                }
+                if(area->nparams > DIRTY_AREA_PARAMS) {
+                        ret = -EINVAL;
+                        goto unlock;
+                }
+        }
+
+        if(!pl_parallel_dirty_scan(dirty, pd->ctrl->buf, !dirty->valid || 
+                                   (flags & PL_PAR_DIRTY_FULL)))
+                goto unlock;
+        dirty->valid = 0;
+
+        pend = dirty->pend;
+        next = dirty->next;
+        for(r = 0; r <= dirty->rows; r++) {
+                nnext = 0;
+                for(c = 0; r < dirty->rows && c < dirty->cols; c++) {
+                        if(!test_bit(r * dirty->cols + c, dirty->map))
+                                continue;
+
+                        c0 = c;
+                        while(c + 1 < dirty->cols && 
+                              test_bit(r * dirty->cols + c + 1, dirty->map))
+                                c++;
+
+                        for(i = 0; i < npend; i++) {
+                                if(pend[i].c0 == c0 && pend[i].c1 == c + 1)
+                                        break;
+                        }
+                        if(i < npend) {
+                                next[nnext] = pend[i];
+                                pend[i].c1 = 0;
+                        } else {
+                                next[nnext].c0 = c0;
+                                next[nnext].c1 = c + 1;
+                                next[nnext].r0 = r;
+                        }
+                        nnext++;
+                }
+
+                // pending rectangles which were not extended are complete
+                for(i = 0; i < npend; i++) {
+                        if(!pend[i].c1)
+                                continue;
+                        ret = pl_parallel_dirty_send(pd, prio, dirty, area, 
+                                                     chunk, &pend[i], r);
+                        if(ret)
+                                goto unlock;
+                        nrects++;
+                }
+
+                swap(pend, next);
+                npend = nnext;
+        }
+
+        dirty->valid = 1;
+        ret = nrects;
+
+unlock:
+        mutex_unlock(&pf->lock);
+        pl_parallel_pool_put(pd, chunk);
+        return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Framebuffer
+
+#ifdef PL_PAR_FB
+
+/*
+ * Optional 8bpp grayscale fbdev front-end. Pages written through mmap() and 
+ * the areas drawn by the fb ops are collected for fb-defer-ms and sent as one
+ * rectangle: fb-area-cmd followed by x, y, w and h, fb-adr with the pixels 
+ * packed to fb-bus-bpp and fb-end-cmd.
+ */
+struct pl_parallel_fb {
+        struct pl_parallel_dev *pd;
+        struct fb_deferred_io defio;
+        spinlock_t lock;
+        unsigned int x0, y0, x1, y1;
+        unsigned short adr;
+        unsigned short area_cmd[FB_CMD_MAX];
+        unsigned int area_len;
+        unsigned short end_cmd[FB_CMD_MAX];
+        unsigned int end_len;
+        unsigned int bus_bpp;
+        int pixel_profile;
+};
+
+// adds an area to the damage, empty as long as x1 is 0
+static void pl_parallel_fb_damage(struct fb_info *info, unsigned int x, 
+                                  unsigned int y, unsigned int w, 
+                                  unsigned int h)
+{
+        struct pl_parallel_fb *fb = info->par;
+        unsigned int x1 = min(x + w, info->var.xres);
+        unsigned int y1 = min(y + h, info->var.yres);
+        unsigned long flags;
+
+        if(x >= x1 || y >= y1)
+                return;
+
+        spin_lock_irqsave(&fb->lock, flags);
+        if(!fb->x1) {
+                fb->x0 = x;
+                fb->y0 = y;
+                fb->x1 = x1;
+                fb->y1 = y1;
+        } else {
+                fb->x0 = min(fb->x0, x);
+                fb->y0 = min(fb->y0, y);
+                fb->x1 = max(fb->x1, x1);
+                fb->y1 = max(fb->y1, y1);
+        }
+        spin_unlock_irqrestore(&fb->lock, flags);
+
+        schedule_delayed_work(&info->deferred_work, fb->defio.delay);
+}
+
+static int pl_parallel_fb_send(struct fb_info *info, unsigned short *chunk,
+                               unsigned int x0, unsigned int y0, 
+                               unsigned int x1, unsigned int y1)
+{
+        struct pl_parallel_fb *fb = info->par;
+        struct pl_parallel_dev *pd = fb->pd;
+        struct controller *ctrl = pd->ctrl;
+        unsigned short *buf = &chunk[1];
+        unsigned int ppw = 16 / fb->bus_bpp;
+        size_t n = 0, words, max = pd->pool.chunk_size / sizeof(*chunk) - 2;
+        const u8 *src;
+        unsigned int y;
+        ssize_t ret = 0;
+
+        // the rectangle has to cover whole bus words
+        x0 = round_down(x0, ppw);
+        x1 = round_up(x1, ppw);
+        words = (x1 - x0) / ppw;
+
+        pl_parallel_bus_wait(pd, PL_PAR_PRIO_INTERACTIVE, 0);
+
+        if(fb->area_len) {
+                memcpy(chunk, fb->area_cmd, fb->area_len * sizeof(*chunk));
+                chunk[fb->area_len] = x0;
+                chunk[fb->area_len + 1] = y0;
+                chunk[fb->area_len + 2] = x1 - x0;
+                chunk[fb->area_len + 3] = y1 - y0;
+                ret = ctrl->write(ctrl, chunk, fb->area_len + 4);
+        }
+
+        if(fb->pixel_profile)
+                pl_parallel_set_profile(pd, CTRL_PROFILE_PIXEL);
+        buf[0] = fb->adr;
+        for(y = y0; y < y1 && ret >= 0; y++) {
+                if(n + words > max) {
+                        ret = ctrl->write(ctrl, buf, n + 1);
+                        buf[0] = __UINT16_MAX__;
+                        n = 0;
+                        if(ret < 0)
+                                break;
+                }
+
+                src = (u8 *)info->screen_buffer + 
+                      y * info->fix.line_length + x0;
+                if(fb->bus_bpp == 8)
+                        memcpy(&buf[1 + n], src, words * sizeof(*buf));
+                else
+                        pl_parallel_pack_words(&buf[1 + n], src, words, 
+                                               fb->bus_bpp);
+                n += words;
+        }
+        if(ret >= 0 && n)
+                ret = ctrl->write(ctrl, buf, n + 1);
+        if(fb->pixel_profile)
+                pl_parallel_set_profile(pd, CTRL_PROFILE_REG);
+
+        if(ret >= 0 && fb->end_len)
+                ret = ctrl->write(ctrl, fb->end_cmd, fb->end_len);
+        pl_parallel_bus_unlock(pd);
+
+        return (ret < 0) ? ret : 0;
+}
+
+/*
+ * Runs once the deferral window has passed. The written pages make up full
+ * lines, which are merged with the damage of the fb ops into one rectangle.
+ */
+static void pl_parallel_fb_deferred_io(struct fb_info *info, 
+                                       struct list_head *pagelist)
+{
+        struct pl_parallel_fb *fb = info->par;
+        unsigned int line = info->fix.line_length;
+        unsigned long lo = ULONG_MAX, hi = 0;
+        unsigned int x0, y0, x1, y1;
+        unsigned short *chunk;
+        unsigned long flags;
+        struct page *page;
+        int ret;
+
+        spin_lock_irqsave(&fb->lock, flags);
+        x0 = fb->x0;
+        y0 = fb->y0;
+        x1 = fb->x1;
+        y1 = fb->y1;
+        fb->x1 = 0;
+        spin_unlock_irqrestore(&fb->lock, flags);
+
+        list_for_each_entry(page, pagelist, lru) {
+                lo = min(lo, page->index);
+                hi = max(hi, page->index);
+        }
+        if(lo <= hi) {
+                if(!x1) {
+                        y0 = UINT_MAX;
+                        y1 = 0;
+                }
+                x0 = 0;
+                x1 = info->var.xres;
+                y0 = min_t(unsigned int, y0, lo * PAGE_SIZE / line);
+                y1 = max_t(unsigned int, y1, 
+                           min_t(unsigned long, info->var.yres, 
+                                 DIV_ROUND_UP((hi + 1) * PAGE_SIZE, line)));
+        }
+
+        if(!x1)
+                return;
+
+        chunk = pl_parallel_pool_get(fb->pd);
+        if(IS_ERR(chunk))
+                return;
+
+        ret = pl_parallel_fb_send(info, chunk, x0, y0, x1, y1);
+        if(ret)
+                pr_warn("%s: Framebuffer update failed (%d)!\n", 
+                        THIS_MODULE->name, ret);
+
+        pl_parallel_pool_put(fb->pd, chunk);
+}
+
+static ssize_t pl_parallel_fb_write(struct fb_info *info, 
+                                    const char __user *buf, size_t count, 
+                                    loff_t *ppos)
+{
+        unsigned int line = info->fix.line_length;
+        loff_t start = *ppos;
+        ssize_t ret;
+
+        ret = fb_sys_write(info, buf, count, ppos);
+        if(ret > 0)
+                pl_parallel_fb_damage(info, 0, start / line, info->var.xres, 
+                                      (*ppos - 1) / line - start / line + 1);
+        return ret;
+}
+
+static void pl_parallel_fb_fillrect(struct fb_info *info, 
+                                    const struct fb_fillrect *rect)
+{
+        sys_fillrect(info, rect);
+        pl_parallel_fb_damage(info, rect->dx, rect->dy, rect->width, 
+                              rect->height);
+}
+
+static void pl_parallel_fb_copyarea(struct fb_info *info, 
+                                    const struct fb_copyarea *area)
+{
+        sys_copyarea(info, area);
+        pl_parallel_fb_damage(info, area->dx, area->dy, area->width, 
+                              area->height);
+}
+
+static void pl_parallel_fb_imageblit(struct fb_info *info, 
+                                     const struct fb_image *image)
+{
+        sys_imageblit(info, image);
+        pl_parallel_fb_damage(info, image->dx, image->dy, image->width, 
+                              image->height);
+}
+
+static struct fb_ops pl_parallel_fb_ops = {
+        .owner = THIS_MODULE,
+        .fb_read = fb_sys_read,
+        .fb_write = pl_parallel_fb_write,
+        .fb_fillrect = pl_parallel_fb_fillrect,
+        .fb_copyarea = pl_parallel_fb_copyarea,
+        .fb_imageblit = pl_parallel_fb_imageblit,
+};
+
+// reads a command of up to FB_CMD_MAX words, a missing property is empty
+static int pl_parallel_fb_read_cmd(struct device_node *np, const char *prop,
+                                   unsigned short *cmd, unsigned int max)
+{
+        u32 val[FB_CMD_MAX];
+        int i, ret;
+
+        ret = of_property_read_variable_u32_array(np, prop, val, 1, max);
+        if(ret == -EINVAL)
+                return 0;
+        if(ret < 0)
+                return ret;
+
+        for(i = 0; i < ret; i++)
+                cmd[i] = val[i];
+        return ret;
+}
+
+static int pl_parallel_fb_init(struct pl_parallel_dev *pd, 
+                               struct platform_device *pdev)
+{
+        struct device_node *np = pdev->dev.of_node;
+        u32 width, height, adr, bus_bpp = 8, defer_ms = FB_DEFER_MS;
+        struct pl_parallel_fb *fb;
+        struct fb_info *info;
+        int ret;
+
+        // the framebuffer is only created if it is configured
+        if(!np || of_property_read_u32(np, FB_WIDTH_PROP, &width))
+                return 0;
+
+        if(of_property_read_u32(np, FB_HEIGHT_PROP, &height) || 
+           of_property_read_u32(np, FB_ADR_PROP, &adr))
+                return -EINVAL;
+        of_property_read_u32(np, FB_BUS_BPP_PROP, &bus_bpp);
+        of_property_read_u32(np, FB_DEFER_MS_PROP, &defer_ms);
+
+        if(!width || !height || !is_power_of_2(bus_bpp) || bus_bpp > 8 || 
+           (width * bus_bpp) % 16 || 
+           width * bus_bpp / 16 > pd->pool.chunk_size / sizeof(short) - 2)
+                return -EINVAL;
+
+        info = framebuffer_alloc(sizeof(*fb), pd->dev);
+        if(!info)
+                return -ENOMEM;
+
+        fb = info->par;
+        fb->pd = pd;
+        spin_lock_init(&fb->lock);
+        fb->adr = adr;
+        fb->bus_bpp = bus_bpp;
+        fb->pixel_profile = of_property_read_bool(np, FB_PIXEL_PROFILE_PROP);
+
+        // the area command leaves room for x, y, w and h
+        ret = pl_parallel_fb_read_cmd(np, FB_AREA_CMD_PROP, fb->area_cmd, 
+                                      FB_CMD_MAX - 4);
+        if(ret < 0)
+                goto cmd_fail;
+        fb->area_len = ret;
+
+        ret = pl_parallel_fb_read_cmd(np, FB_END_CMD_PROP, fb->end_cmd, 
+                                      FB_CMD_MAX);
+        if(ret < 0)
+                goto cmd_fail;
+        fb->end_len = ret;
+
+        info->screen_buffer = vzalloc(PAGE_ALIGN(width * height));
+        if(!info->screen_buffer) {
+                ret = -ENOMEM;
+                goto cmd_fail;
+        }
+        info->screen_size = width * height;
+
+        strlcpy(info->fix.id, DEVICE_NAME, sizeof(info->fix.id));
+        info->fix.type = FB_TYPE_PACKED_PIXELS;
+        info->fix.visual = FB_VISUAL_STATIC_PSEUDOCOLOR;
+        info->fix.accel = FB_ACCEL_NONE;
+        info->fix.line_length = width;
+        info->fix.smem_len = width * height;
+
+        info->var.xres = width;
+        info->var.yres = height;
+        info->var.xres_virtual = width;
+        info->var.yres_virtual = height;
+        info->var.bits_per_pixel = 8;
+        info->var.grayscale = 1;
+        info->var.red.length = 8;
+        info->var.green.length = 8;
+        info->var.blue.length = 8;
+
+        info->fbops = &pl_parallel_fb_ops;
+        info->flags = FBINFO_FLAG_DEFAULT | FBINFO_VIRTFB;
+
+        fb->defio.delay = msecs_to_jiffies(defer_ms);
+        fb->defio.deferred_io = pl_parallel_fb_deferred_io;
+        info->fbdefio = &fb->defio;
+        fb_deferred_io_init(info);
+
+        ret = register_framebuffer(info);
+        if(ret)
+                goto register_fail;
+
+        pd->fb = info;
+        return 0;
+
+register_fail:
+        fb_deferred_io_cleanup(info);
+        vfree(info->screen_buffer);
+cmd_fail:
+        framebuffer_release(info);
+        return ret;
+}
+
+static void pl_parallel_fb_destroy(struct pl_parallel_dev *pd)
+{
+        struct fb_info *info = pd->fb;
+
+        if(!info)
+                return;
+
+        unregister_framebuffer(info);
+        fb_deferred_io_cleanup(info);
+        vfree(info->screen_buffer);
+        framebuffer_release(info);
+}
+
+#else
+
+static inline int pl_parallel_fb_init(struct pl_parallel_dev *pd, 
+                                      struct platform_device *pdev)
+{
+        return 0;
+}
+
+static inline void pl_parallel_fb_destroy(struct pl_parallel_dev *pd)
+{
+}
+
+#endif /* PL_PAR_FB */
 
 ////////////////////////////////////////////////////////////////////////////////
 // Cdev
 
 static int pl_parallel_open(struct inode *inode, struct file *file)
 {
+        struct pl_parallel_file *pf;
+
+        pf = kzalloc(sizeof(*pf), GFP_KERNEL);
+        if(!pf)
+                return -ENOMEM;
+
+        pf->pd = container_of(inode->i_cdev, struct pl_parallel_dev, cdev);
+        mutex_init(&pf->lock);
+        INIT_WORK(&pf->ring_work, pl_parallel_ring_work);
+        spin_lock_init(&pf->queue_lock);
+        INIT_WORK(&pf->write_work, pl_parallel_write_work);
+        init_waitqueue_head(&pf->wait);
+        idr_init(&pf->dls);
+        file->private_data = pf;
         return 0;
 }
 
 static int pl_parallel_release(struct inode *inode, struct file *file)
 {
+        struct pl_parallel_file *pf = file->private_data;
+        struct pl_parallel_dl *dl;
+        int id;
+
+        // queued writes are still sent
+        flush_work(&pf->write_work);
+
+        idr_for_each_entry(&pf->dls, dl, id)
+                pl_parallel_dl_free(dl);
+        idr_destroy(&pf->dls);
+        pl_parallel_dirty_free(pf->dirty);
+
+        if(pf->ring) {
+                cancel_work_sync(&pf->ring_work);
+                vfree(pf->ring);
+        }
+        kfree(pf);
         return 0;
 }
 
-static ssize_t pl_parallel_read(struct file *file, char __user *data,
-                                size_t size, loff_t *offset)
+/*
+ * In positional mode pos is the address, which is sent along with the read.
+ * Otherwise the data follows the address of the last write.
+ */
+static ssize_t pl_parallel_do_read(struct file *file, struct iov_iter *to,
+                                   loff_t pos)
 {
         int ret = 0;
-        unsigned long c, cnt = 0;
-        unsigned char *read_buffer, *src, *dst;
-        
-        read_buffer = kmalloc(size, GFP_KERNEL);
-        if(!read_buffer)
-                return -ENOMEM;
+        size_t size = iov_iter_count(to);
+        void __user *data = pl_parallel_iter_buf(to);
+        unsigned short adr = __UINT16_MAX__, *chunk;
+        struct pl_parallel_file *pf = file->private_data;
+        struct pl_parallel_dev *pd = pf->pd;
+        struct controller *ctrl = pd->ctrl;
 
-        ret = ctrl->read(ctrl, (unsigned short *)read_buffer, size / 2);
-        if(ret < 0)
-                goto err;
+        if(READ_ONCE(pf->positional)) {
+                if(pos < 0 || pos > __UINT16_MAX__)
+                        return -EINVAL;
+                adr = pos;
+        }
 
-        src = read_buffer;
-        dst = data;
+        // a read has to follow the queued writes (e.g. the address)
+        if(file->f_flags & O_NONBLOCK) {
+                if(READ_ONCE(pf->queued))
+                        return -EAGAIN;
+                if(ctrl->poll_ready && !ctrl->poll_ready(ctrl, file, NULL))
+                        return -EAGAIN;
+        } else {
+                ret = pl_parallel_write_drain(pf);
+                if(ret)
+                        return ret;
+        }
 
-        while(size) {
-                c = (size > PAGE_SIZE) ? PAGE_SIZE : size;
+        // non-blocking reads go through the pool to bound their HRDY waits
+        if(!(file->f_flags & O_NONBLOCK) && ctrl->read_sg && 
+           pl_parallel_use_zc(pd, data, size)) {
+                ret = pl_parallel_read_zc(pd, READ_ONCE(pf->prio), adr, 
+                                          data, size / 2);
+                return (ret) ? ret : size & ~1ul;
+        }
 
-                if(copy_to_user(dst, src, c)) {
-                        ret = -EFAULT;
-                        break;
-                }
+        chunk = pl_parallel_pool_get(pd);
+        if(IS_ERR(chunk))
+                return PTR_ERR(chunk);
 
-                src += c;
-                dst += c;
-                cnt += c;       
-                size -= c;
-        }
+        ret = pl_parallel_bus_lock(pd, READ_ONCE(pf->prio));
+        if(ret)
+                goto err;
+        if(file->f_flags & O_NONBLOCK)
+                ctrl->xfer_hrdy_timeout = NONBLOCK_HRDY_TIMEOUT_MSECS;
+        if(adr != __UINT16_MAX__)
+                ret = ctrl->write(ctrl, &adr, 1);
+        if(ret >= 0)
+                ret = pl_parallel_read_user(pd, chunk, to, size / 2);
+        ctrl->xfer_hrdy_timeout = 0;
+        pl_parallel_bus_unlock(pd);
 
 err:
-        kfree(read_buffer);
-        return (ret) ? ret : cnt;
+        pl_parallel_pool_put(pd, chunk);
+        return (ret) ? ret : size & ~1ul;
 }
 
-static ssize_t pl_parallel_write(struct file *file, const char __user *data,
-                                 size_t size, loff_t *offset)
+/*
+ * The first word of the data is the address, the rest can be scattered over
+ * several user buffers (writev()) and is still sent as one transfer. In 
+ * positional mode pos is the address and all of the data is sent after it.
+ */
+static ssize_t pl_parallel_do_write(struct file *file, struct iov_iter *from,
+                                    loff_t pos)
 {
-        unsigned char *data_buf, *dst;
-        const unsigned char *src;
-        unsigned long c, cnt = 0;
+        unsigned short adr, *chunk;
+        enum ctrl_profile profile;
+        size_t size = iov_iter_count(from), dsize = size;
+        void __user *data;
         int ret = 0;
+        struct pl_parallel_file *pf = file->private_data;
+        struct pl_parallel_dev *pd = pf->pd;
+        struct controller *ctrl = pd->ctrl;
+        enum pl_par_prio prio = READ_ONCE(pf->prio);
+        unsigned int pack = READ_ONCE(pf->pack_bpp);
+        size_t len;
+
+        if(READ_ONCE(pf->positional)) {
+                if(pos < 0 || pos > __UINT16_MAX__)
+                        return -EINVAL;
+                adr = pos;
+        } else {
+                if(size < 2)
+                        return -EINVAL;
+                if(copy_from_iter(&adr, sizeof(adr), from) != sizeof(adr))
+                        return -EFAULT;
+                dsize -= sizeof(adr);
+        }
 
-        if(size < 2)
+        // packed pixels have to fill whole words
+        if(pack && dsize % (16 / pack))
                 return -EINVAL;
+        len = pack ? dsize / (16 / pack) : dsize / 2;
 
-        data_buf = kmalloc(size, GFP_KERNEL);
-        if(!data_buf)
-                return -ENOMEM;
+        // a queued write has to fit into one chunk
+        if(file->f_flags & O_NONBLOCK) {
+                if(len > pl_parallel_write_queue_max(pd))
+                        return -EINVAL;
+                ret = pl_parallel_write_queued(pf, adr, from, len, pack);
+                return (ret) ? ret : size;
+        }
 
-        src = data;
-        dst = data_buf;
+        ret = pl_parallel_write_drain(pf);
+        if(ret)
+                return ret;
 
-        while(size) {
-                c = (size > PAGE_SIZE) ? PAGE_SIZE : size;
-                if(copy_from_user(dst, src, c)) {
-                        ret = -EFAULT;
-                        goto err;
-                }
+        profile = pl_parallel_write_profile(pd, size);
 
-                dst += c;
-                src += c;
-                cnt += c;
-                size -= c;
+        data = pl_parallel_iter_buf(from);
+        if(!pack && ctrl->write_sg && pl_parallel_use_zc(pd, data, dsize)) {
+                ret = pl_parallel_write_zc(pd, prio, adr, data, len, profile);
+                return (ret) ? ret : size;
         }
 
-        ret = ctrl->write(ctrl, (unsigned short *)data_buf, cnt / 2);
+        chunk = pl_parallel_pool_get(pd);
+        if(IS_ERR(chunk))
+                return PTR_ERR(chunk);
+
+        ret = pl_parallel_bus_lock(pd, prio);
+        if(ret)
+                goto err;
+        pl_parallel_set_profile(pd, profile);
+        ret = pl_parallel_write_user(pd, prio, chunk, adr, from, len, pack);
+        pl_parallel_set_profile(pd, CTRL_PROFILE_REG);
+        pl_parallel_bus_unlock(pd);
         
 err:
-        kfree(data_buf);
-        return (ret) ? ret : cnt;
+        pl_parallel_pool_put(pd, chunk);
+        return (ret) ? ret : size;
+}
+
+static ssize_t pl_parallel_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+        size_t size = iov_iter_count(to);
+        ssize_t ret;
+
+        trace_pl_par_read_enter(size);
+        ret = pl_parallel_do_read(iocb->ki_filp, to, iocb->ki_pos);
+        trace_pl_par_read_exit(size, ret);
+        return ret;
+}
+
+static ssize_t pl_parallel_write_iter(struct kiocb *iocb, 
+                                      struct iov_iter *from)
+{
+        size_t size = iov_iter_count(from);
+        ssize_t ret;
+
+        trace_pl_par_write_enter(size);
+        ret = pl_parallel_do_write(iocb->ki_filp, from, iocb->ki_pos);
+        trace_pl_par_write_exit(size, ret);
+        return ret;
+}
+
+/*
+ * Executes one ioctl message through a pool chunk. The bus lock has to be 
+ * held. A batch is never split, whatever the priority of its client.
+ */
+static int pl_parallel_exec_msg(struct pl_parallel_dev *pd,
+                                struct pl_par_ioctl_message *msg,
+                                unsigned short *chunk)
+{
+        struct controller *ctrl = pd->ctrl;
+        void __user *data = (void __user *)msg->data;
+        unsigned short adr = msg->adr;
+        struct iov_iter iter;
+        struct iovec iov;
+        ssize_t ret;
+
+        if(msg->data_size > MAX_RW_COUNT / sizeof(short))
+                return -EINVAL;
+
+        ret = import_single_range(msg->rd_wr == PL_PAR_WRITE ? WRITE : READ,
+                                  data, msg->data_size * sizeof(short), &iov,
+                                  &iter);
+        if(ret)
+                return ret;
+
+        if(msg->rd_wr == PL_PAR_WRITE) {
+                if(msg->disable_data_send || !msg->data_size) {
+                        if(msg->disable_adr_send)
+                                return 0;
+                        ret = ctrl->write(ctrl, &adr, 1);
+                        return (ret < 0) ? ret : 0;
+                }
+
+                if(msg->disable_adr_send)
+                        adr = __UINT16_MAX__;
+
+                // only for this message, the bus lock is held
+                ctrl->xfer_hrdy_interval = msg->hrdy_interval;
+                if(msg->pixel_profile)
+                        pl_parallel_set_profile(pd, CTRL_PROFILE_PIXEL);
+                ret = pl_parallel_write_user(pd, PL_PAR_PRIO_INTERACTIVE, 
+                                             chunk, adr, &iter, 
+                                             msg->data_size, 0);
+                if(msg->pixel_profile)
+                        pl_parallel_set_profile(pd, CTRL_PROFILE_REG);
+                ctrl->xfer_hrdy_interval = 0;
+                return ret;
+        }
+
+        if(!msg->disable_adr_send) {
+                ret = ctrl->write(ctrl, &adr, 1);
+                if(ret < 0)
+                        return ret;
+        }
+
+        if(msg->disable_data_send)
+                return 0;
+
+        return pl_parallel_read_user(pd, chunk, &iter, msg->data_size);
+}
+
+static long pl_parallel_ioctl_transfer(struct pl_parallel_dev *pd,
+                                       enum pl_par_prio prio, void __user *arg)
+{
+        struct pl_par_ioctl_transfer xfer;
+        struct pl_par_ioctl_message *msgs;
+        unsigned short *chunk;
+        unsigned int i;
+        long ret = 0;
+
+        if(copy_from_user(&xfer, arg, sizeof(xfer)))
+                return -EFAULT;
+
+        if(!xfer.nmsgs || xfer.nmsgs > PL_PAR_IOCTL_MAX_MSGS)
+                return -EINVAL;
+
+        msgs = memdup_user((void __user *)xfer.msgs, 
+                           xfer.nmsgs * sizeof(*msgs));
+        if(IS_ERR(msgs))
+                return PTR_ERR(msgs);
+
+        for(i = 0; i < xfer.nmsgs; i++) {
+                if(msgs[i].rd_wr != PL_PAR_READ && 
+                   msgs[i].rd_wr != PL_PAR_WRITE) {
+                        ret = -EINVAL;
+                        goto free_msgs;
+                }
+        }
+
+        // one chunk for the whole batch
+        chunk = pl_parallel_pool_get(pd);
+        if(IS_ERR(chunk)) {
+                ret = PTR_ERR(chunk);
+                goto free_msgs;
+        }
+
+        ret = pl_parallel_bus_lock(pd, prio);
+        if(ret)
+                goto put_chunk;
+
+        for(i = 0; i < xfer.nmsgs; i++) {
+                ret = pl_parallel_exec_msg(pd, &msgs[i], chunk);
+                if(ret)
+                        break;
+        }
+
+        pl_parallel_bus_unlock(pd);
+
+put_chunk:
+        pl_parallel_pool_put(pd, chunk);
+free_msgs:
+        kfree(msgs);
+        return (ret) ? ret : i;
+}
+
+static long pl_parallel_ioctl_flush(struct pl_parallel_dev *pd, 
+                                    enum pl_par_prio prio, void __user *arg)
+{
+        struct controller *ctrl = pd->ctrl;
+        struct pl_par_ioctl_flush flush;
+        unsigned short adr;
+        ssize_t ret;
+
+        if(copy_from_user(&flush, arg, sizeof(flush)))
+                return -EFAULT;
+
+        if(!ctrl->write_buf || !ctrl->buf_size)
+                return -ENODEV;
+
+        if((flush.offset | flush.size) & 1)
+                return -EINVAL;
+
+        if(flush.offset > ctrl->buf_size || 
+           flush.size > ctrl->buf_size - flush.offset)
+                return -EINVAL;
+
+        adr = flush.disable_adr_send ? __UINT16_MAX__ : flush.adr;
+
+        ret = pl_parallel_bus_lock(pd, prio);
+        if(ret)
+                return ret;
+        if(flush.pixel_profile)
+                pl_parallel_set_profile(pd, CTRL_PROFILE_PIXEL);
+        ret = pl_parallel_write_buf(pd, prio, adr, flush.offset / 2, 
+                                    flush.size / 2);
+        pl_parallel_set_profile(pd, CTRL_PROFILE_REG);
+        pl_parallel_bus_unlock(pd);
+
+        return (ret < 0) ? ret : 0;
+}
+
+static long pl_parallel_ioctl_calibrate(struct pl_parallel_dev *pd,
+                                        void __user *arg)
+{
+        struct controller *ctrl = pd->ctrl;
+        struct pl_par_ioctl_calibrate cal;
+        int ret;
+
+        if(!ctrl->calibrate)
+                return -ENOTTY;
+
+        if(copy_from_user(&cal, arg, sizeof(cal)))
+                return -EFAULT;
+
+        ret = pl_parallel_bus_lock(pd, PL_PAR_PRIO_INTERACTIVE);
+        if(ret)
+                return ret;
+        ret = ctrl->calibrate(ctrl, &cal);
+        pl_parallel_bus_unlock(pd);
+        if(ret)
+                return ret;
+
+        if(copy_to_user(arg, &cal, sizeof(cal)))
+                return -EFAULT;
+        return 0;
+}
+
+static long pl_parallel_ioctl(struct file *file, unsigned int cmd, 
+                              unsigned long arg)
+{
+        struct pl_parallel_file *pf = file->private_data;
+        struct controller *ctrl = pf->pd->ctrl;
+        int ret;
+
+        switch(cmd) {
+        case PL_PAR_IOCTL_TRANSFER:
+                ret = pl_parallel_write_drain(pf);
+                if(ret)
+                        return ret;
+                return pl_parallel_ioctl_transfer(pf->pd, READ_ONCE(pf->prio),
+                                                  (void __user *)arg);
+        case PL_PAR_IOCTL_BUF_SIZE:
+                return put_user((unsigned int)ctrl->buf_size, 
+                                (unsigned int __user *)arg);
+        case PL_PAR_IOCTL_FLUSH:
+                ret = pl_parallel_write_drain(pf);
+                if(ret)
+                        return ret;
+                return pl_parallel_ioctl_flush(pf->pd, READ_ONCE(pf->prio),
+                                               (void __user *)arg);
+        case PL_PAR_IOCTL_RING_ENTER:
+                return pl_parallel_ioctl_ring_enter(pf, arg);
+        case PL_PAR_IOCTL_PRIO:
+                if(arg != PL_PAR_PRIO_INTERACTIVE && arg != PL_PAR_PRIO_BULK)
+                        return -EINVAL;
+                WRITE_ONCE(pf->prio, arg);
+                return 0;
+        case PL_PAR_IOCTL_DIRTY_SETUP:
+                return pl_parallel_ioctl_dirty_setup(pf, (void __user *)arg);
+        case PL_PAR_IOCTL_DIRTY_FLUSH:
+                ret = pl_parallel_write_drain(pf);
+                if(ret)
+                        return ret;
+                return pl_parallel_ioctl_dirty_flush(pf, READ_ONCE(pf->prio),
+                                                     arg);
+        case PL_PAR_IOCTL_POSITIONAL:
+                WRITE_ONCE(pf->positional, !!arg);
+                return 0;
+        case PL_PAR_IOCTL_PACK:
+                if(arg != 1 && arg != 2 && arg != 4 && arg != 8)
+                        return -EINVAL;
+                WRITE_ONCE(pf->pack_bpp, (arg == 8) ? 0 : arg);
+                return 0;
+        case PL_PAR_IOCTL_CALIBRATE:
+                ret = pl_parallel_write_drain(pf);
+                if(ret)
+                        return ret;
+                return pl_parallel_ioctl_calibrate(pf->pd, (void __user *)arg);
+        case PL_PAR_IOCTL_DL_CREATE:
+                return pl_parallel_ioctl_dl_create(pf, (void __user *)arg);
+        case PL_PAR_IOCTL_DL_EXEC:
+                ret = pl_parallel_write_drain(pf);
+                if(ret)
+                        return ret;
+                return pl_parallel_ioctl_dl_exec(pf, READ_ONCE(pf->prio),
+                                                 (void __user *)arg);
+        case PL_PAR_IOCTL_DL_DESTROY:
+                return pl_parallel_ioctl_dl_destroy(pf, arg);
+        default:
+                return -ENOTTY;
+        }
+}
+
+/*
+ * EPOLLOUT: the write queue has room and a pool chunk is free.
+ * EPOLLIN:  ring completions are pending or, with no writes queued, the 
+ *           device signals that it is ready for a transfer.
+ * EPOLLERR: a queued write has failed.
+ */
+static __poll_t pl_parallel_poll(struct file *file, poll_table *wait)
+{
+        struct pl_parallel_file *pf = file->private_data;
+        struct pl_par_ring *ring = READ_ONCE(pf->ring);
+        struct controller *ctrl = pf->pd->ctrl;
+        __poll_t mask = 0;
+
+        poll_wait(file, &pf->wait, wait);
+        poll_wait(file, &pf->pd->pool.wait, wait);
+
+        if(READ_ONCE(pf->queued) < pl_parallel_write_queue_depth(pf->pd) && 
+           READ_ONCE(pf->pd->pool.nfree))
+                mask |= EPOLLOUT | EPOLLWRNORM;
+
+        if(READ_ONCE(pf->error))
+                mask |= EPOLLERR;
+
+        if(ring && READ_ONCE(pf->cq_tail) != READ_ONCE(ring->cq_head))
+                mask |= EPOLLIN | EPOLLRDNORM;
+        else if(!READ_ONCE(pf->queued) && ctrl->poll_ready && 
+                ctrl->poll_ready(ctrl, file, wait))
+                mask |= EPOLLIN | EPOLLRDNORM;
+
+        return mask;
+}
+
+static int pl_parallel_mmap(struct file *file, struct vm_area_struct *vma)
+{
+        struct pl_parallel_file *pf = file->private_data;
+        struct controller *ctrl = pf->pd->ctrl;
+
+        if(vma->vm_pgoff == PL_PAR_RING_MMAP_OFFSET >> PAGE_SHIFT)
+                return pl_parallel_ring_mmap(pf, vma);
+
+        if(!ctrl->mmap)
+                return -ENODEV;
+
+        return ctrl->mmap(ctrl, vma);
 }
 
 static struct file_operations pl_parallel_fops = {
         .owner = THIS_MODULE,
         .open = pl_parallel_open,
         .release = pl_parallel_release,
-        .read = pl_parallel_read,
-        .write = pl_parallel_write,
+        .read_iter = pl_parallel_read_iter,
+        .write_iter = pl_parallel_write_iter,
+        .unlocked_ioctl = pl_parallel_ioctl,
+        .mmap = pl_parallel_mmap,
+        .poll = pl_parallel_poll,
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -173,22 +2574,28 @@ static struct controller *get_controller_by_dev_id(struct platform_device *pdev,
 ////////////////////////////////////////////////////////////////////////////////
 // Class
 
-static ssize_t burst_en_show(struct class *c, struct class_attribute *attr, 
+static ssize_t burst_en_show(struct device *dev, struct device_attribute *attr,
                              char *buffer)
 {
+        struct pl_parallel_dev *pd = dev_get_drvdata(dev);
+        struct controller *ctrl = READ_ONCE(pd->ctrl);
+
         if(!ctrl)
                 return -ENODEV;
-        else
-                return sprintf(buffer, "%d\n", ctrl->burst_en);
+
+        return sprintf(buffer, "%d\n", ctrl->burst_en);
 }
 
-static ssize_t burst_en_store(struct class *c, struct class_attribute *attr, 
+static ssize_t burst_en_store(struct device *dev, struct device_attribute *attr,
                               const char *buffer, size_t len)
 {
+        struct pl_parallel_dev *pd = dev_get_drvdata(dev);
+        struct controller *ctrl = READ_ONCE(pd->ctrl);
         int ret;
+
         if(!ctrl)
                 return -ENODEV;
-        
+
         ret = kstrtoint(buffer, 10, &ctrl->burst_en);
 
         if(ret) {
@@ -198,10 +2605,142 @@ static ssize_t burst_en_store(struct class *c, struct class_attribute *attr,
         return len;
 }
 
-CLASS_ATTR_RW(burst_en);
+static DEVICE_ATTR_RW(burst_en);
+
+static ssize_t hrdy_interval_show(struct device *dev, 
+                                  struct device_attribute *attr, char *buffer)
+{
+        struct pl_parallel_dev *pd = dev_get_drvdata(dev);
+        struct controller *ctrl = READ_ONCE(pd->ctrl);
+
+        if(!ctrl)
+                return -ENODEV;
+
+        return sprintf(buffer, "%u\n", READ_ONCE(ctrl->hrdy_interval));
+}
+
+static ssize_t hrdy_interval_store(struct device *dev, 
+                                   struct device_attribute *attr,
+                                   const char *buffer, size_t len)
+{
+        struct pl_parallel_dev *pd = dev_get_drvdata(dev);
+        struct controller *ctrl = READ_ONCE(pd->ctrl);
+        unsigned int interval;
+        int ret;
+
+        if(!ctrl)
+                return -ENODEV;
+
+        ret = kstrtouint(buffer, 10, &interval);
+        if(ret)
+                return ret;
+        if(!interval)
+                return -EINVAL;
+
+        WRITE_ONCE(ctrl->hrdy_interval, interval);
+        return len;
+}
+
+static DEVICE_ATTR_RW(hrdy_interval);
+
+static ssize_t read_hrdy_interval_show(struct device *dev, 
+                                       struct device_attribute *attr, 
+                                       char *buffer)
+{
+        struct pl_parallel_dev *pd = dev_get_drvdata(dev);
+        struct controller *ctrl = READ_ONCE(pd->ctrl);
+
+        if(!ctrl)
+                return -ENODEV;
+
+        return sprintf(buffer, "%u\n", READ_ONCE(ctrl->read_hrdy_interval));
+}
+
+static ssize_t read_hrdy_interval_store(struct device *dev, 
+                                        struct device_attribute *attr,
+                                        const char *buffer, size_t len)
+{
+        struct pl_parallel_dev *pd = dev_get_drvdata(dev);
+        struct controller *ctrl = READ_ONCE(pd->ctrl);
+        unsigned int interval;
+        int ret;
+
+        if(!ctrl)
+                return -ENODEV;
+
+        ret = kstrtouint(buffer, 10, &interval);
+        if(ret)
+                return ret;
+
+        WRITE_ONCE(ctrl->read_hrdy_interval, interval);
+        return len;
+}
+
+static DEVICE_ATTR_RW(read_hrdy_interval);
+
+static ssize_t zc_threshold_show(struct device *dev, 
+                                 struct device_attribute *attr, char *buffer)
+{
+        struct pl_parallel_dev *pd = dev_get_drvdata(dev);
+
+        return sprintf(buffer, "%u\n", READ_ONCE(pd->zc_threshold));
+}
+
+static ssize_t zc_threshold_store(struct device *dev, 
+                                  struct device_attribute *attr,
+                                  const char *buffer, size_t len)
+{
+        struct pl_parallel_dev *pd = dev_get_drvdata(dev);
+        unsigned int threshold;
+        int ret;
+
+        ret = kstrtouint(buffer, 10, &threshold);
+        if(ret)
+                return ret;
+
+        // pinning a few pages costs more than copying them
+        if(threshold && threshold < PAGE_SIZE)
+                threshold = PAGE_SIZE;
+
+        WRITE_ONCE(pd->zc_threshold, threshold);
+        return len;
+}
+
+static DEVICE_ATTR_RW(zc_threshold);
+
+static ssize_t pixel_threshold_show(struct device *dev, 
+                                    struct device_attribute *attr, 
+                                    char *buffer)
+{
+        struct pl_parallel_dev *pd = dev_get_drvdata(dev);
+
+        return sprintf(buffer, "%u\n", READ_ONCE(pd->pixel_threshold));
+}
+
+static ssize_t pixel_threshold_store(struct device *dev, 
+                                     struct device_attribute *attr,
+                                     const char *buffer, size_t len)
+{
+        struct pl_parallel_dev *pd = dev_get_drvdata(dev);
+        unsigned int threshold;
+        int ret;
+
+        ret = kstrtouint(buffer, 10, &threshold);
+        if(ret)
+                return ret;
+
+        WRITE_ONCE(pd->pixel_threshold, threshold);
+        return len;
+}
+
+static DEVICE_ATTR_RW(pixel_threshold);
 
 static struct attribute *pl_par_attrs[] = {
-        &class_attr_burst_en.attr,
+        &dev_attr_burst_en.attr,
+        &dev_attr_hrdy_interval.attr,
+        &dev_attr_read_hrdy_interval.attr,
+        &dev_attr_zc_threshold.attr,
+        &dev_attr_pixel_threshold.attr,
         NULL,
 };
 
@@ -210,7 +2749,6 @@ ATTRIBUTE_GROUPS(pl_par);
 static struct class pl_parallel_class = {
         .name = CLASS_NAME,
         .owner = THIS_MODULE,
-        .class_groups = pl_par_groups,
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -219,7 +2757,8 @@ static struct class pl_parallel_class = {
 static int pl_parallel_probe(struct platform_device *pdev)
 {
         int ret;
-        struct device *cdev_dev_tmp;
+        struct pl_parallel_dev *pd;
+        struct controller *ctrl;
         struct platform_device_id *dev_id;
         // find and create device
         const struct of_device_id *of_id = 
@@ -228,44 +2767,32 @@ static int pl_parallel_probe(struct platform_device *pdev)
         if(!of_id) {
                 pr_err("%s: Cannot find any compatible hardware.\n", 
                         THIS_MODULE->name);
-                ret = -ENODEV;
-                goto of_match_fail;
+                return -ENODEV;
         }
 
-        // register class
-        ret = class_register(&pl_parallel_class);
-        if(ret) {
-                dev_err(&pdev->dev, "Register class failed.\n");
-                goto class_register_fail;
-        }
-        
-        dev_info(&pdev->dev, "Create cdev\n");
-        // create cdev
-        ret = alloc_chrdev_region(&cdev_dev_t, 0, 1, DEVICE_NAME);
-        if(ret) {
-                dev_err(&pdev->dev, "Alloc cdev region failed.\n");
-                goto cdev_region_alloc_fail;
-        }
+        pd = devm_kzalloc(&pdev->dev, sizeof(*pd), GFP_KERNEL);
+        if(!pd)
+                return -ENOMEM;
 
-        pl_parallel_cdev = cdev_alloc();
-        if(!pl_parallel_cdev) {
-                dev_err(&pdev->dev, "Alloc cdev_failed.\n");
-                ret = -ENOMEM;
-                goto cdev_alloc_fail;
-        }
+        pl_parallel_arb_init(&pd->arb);
+        pd->profile = CTRL_PROFILE_REG;
+        pd->zc_threshold = ZC_THRESHOLD;
+        pd->pixel_threshold = 0;
+        platform_set_drvdata(pdev, pd);
 
-        cdev_init(pl_parallel_cdev, &pl_parallel_fops);
-        ret = cdev_add(pl_parallel_cdev, cdev_dev_t, 1);
-        if(ret) {
-                dev_err(&pdev->dev, "Adding cdev failed.\n");
-                goto add_cdev_fail;
+        pd->id = ida_simple_get(&pl_parallel_ida, 0, MAX_DEVICES, GFP_KERNEL);
+        if(pd->id < 0) {
+                dev_err(&pdev->dev, "No free minor.\n");
+                return pd->id;
         }
 
-        cdev_dev_tmp = device_create(&pl_parallel_class, NULL, cdev_dev_t, 
-                                     NULL, DEVICE_NAME);
-        if(IS_ERR(cdev_dev_tmp)) {
-                dev_err(&pdev->dev, "Create cdev device failed.");
-                ret = PTR_ERR(cdev_dev_tmp);
+        pd->dev = device_create_with_groups(&pl_parallel_class, &pdev->dev,
+                                            pl_parallel_devt + pd->id, pd, 
+                                            pl_par_groups, DEVICE_NAME "%d",
+                                            pd->id);
+        if(IS_ERR(pd->dev)) {
+                dev_err(&pdev->dev, "Create cdev device failed.\n");
+                ret = PTR_ERR(pd->dev);
                 goto cdev_dev_create_fail;
         }
 
@@ -279,37 +2806,84 @@ static int pl_parallel_probe(struct platform_device *pdev)
                 goto create_dev_fail;
         }
 
-        ret = ctrl->init(ctrl, pdev, &pl_parallel_class);
+        ctrl->bus_lock = pl_parallel_ctrl_bus_lock;
+        ctrl->bus_unlock = pl_parallel_ctrl_bus_unlock;
+        ctrl->bus_data = pd;
+
+        ret = ctrl->init(ctrl, pdev, pd->dev);
         if(ret) {
                 dev_err(&pdev->dev, "Init parallel device failed.\n");
                 goto init_dev_fail;
         }
 
+        of_property_read_u32(pdev->dev.of_node, HRDY_INTERVAL_PROP, 
+                             &ctrl->hrdy_interval);
+        if(!ctrl->hrdy_interval)
+                ctrl->hrdy_interval = 1;
+        of_property_read_u32(pdev->dev.of_node, READ_HRDY_INTERVAL_PROP, 
+                             &ctrl->read_hrdy_interval);
+
+        // the sysfs attributes are already visible, publish the controller 
+        // only once it is set up
+        smp_store_release(&pd->ctrl, ctrl);
+
+        ret = pl_parallel_pool_init(pd, &pdev->dev);
+        if(ret) {
+                dev_err(&pdev->dev, "Init bounce buffer pool failed.\n");
+                goto pool_init_fail;
+        }
+
+        dev_info(&pdev->dev, "Create cdev\n");
+        cdev_init(&pd->cdev, &pl_parallel_fops);
+        pd->cdev.owner = THIS_MODULE;
+        ret = cdev_add(&pd->cdev, pl_parallel_devt + pd->id, 1);
+        if(ret) {
+                dev_err(&pdev->dev, "Adding cdev failed.\n");
+                goto add_cdev_fail;
+        }
+
+        ret = pl_parallel_fb_init(pd, pdev);
+        if(ret) {
+                dev_err(&pdev->dev, "Init framebuffer failed.\n");
+                goto fb_init_fail;
+        }
+
+        // statistics are optional
+        if(!IS_ERR_OR_NULL(pl_parallel_debugfs)) {
+                pd->debugfs = debugfs_create_dir(dev_name(pd->dev), 
+                                                 pl_parallel_debugfs);
+                if(!IS_ERR_OR_NULL(pd->debugfs) && pd->ctrl->debugfs_init)
+                        pd->ctrl->debugfs_init(pd->ctrl, pd->debugfs);
+        }
+
         return 0;
 
+fb_init_fail:
+        cdev_del(&pd->cdev);
+add_cdev_fail:
+        pl_parallel_pool_destroy(pd);
+pool_init_fail:
+        WRITE_ONCE(pd->ctrl, NULL);
+        ctrl->destroy(ctrl, pdev, pd->dev);
 init_dev_fail:
-        ctrl->destroy(ctrl, pdev, &pl_parallel_class);
-cdev_dev_create_fail:
-        cdev_del(pl_parallel_cdev);
 create_dev_fail:
-add_cdev_fail:
-        devm_kfree(&pdev->dev, pl_parallel_cdev);
-cdev_alloc_fail:
-        unregister_chrdev_region(cdev_dev_t, 1);
-cdev_region_alloc_fail:
-        class_unregister(&pl_parallel_class);
-class_register_fail:
-of_match_fail:
+        device_destroy(&pl_parallel_class, pl_parallel_devt + pd->id);
+cdev_dev_create_fail:
+        ida_simple_remove(&pl_parallel_ida, pd->id);
         return ret;
 }
 
 static int pl_parallel_remove(struct platform_device *pdev)
 {
-        ctrl->destroy(ctrl, pdev, &pl_parallel_class);
-        device_destroy(&pl_parallel_class, cdev_dev_t);
-        class_unregister(&pl_parallel_class);
-        cdev_del(pl_parallel_cdev);
-        unregister_chrdev_region(cdev_dev_t, 1);
+        struct pl_parallel_dev *pd = platform_get_drvdata(pdev);
+
+        debugfs_remove_recursive(pd->debugfs);
+        pl_parallel_fb_destroy(pd);
+        cdev_del(&pd->cdev);
+        pl_parallel_pool_destroy(pd);
+        pd->ctrl->destroy(pd->ctrl, pdev, pd->dev);
+        device_destroy(&pl_parallel_class, pl_parallel_devt + pd->id);
+        ida_simple_remove(&pl_parallel_ida, pd->id);
         return 0;
 }
 
@@ -328,14 +2902,46 @@ static struct platform_driver pl_parallel_driver = {
 
 static int __init pl_parallel_init(void)
 {
+        int ret;
+
         pr_info("%s: Starting module...\n", THIS_MODULE->name);
-        return platform_driver_probe(&pl_parallel_driver, pl_parallel_probe);
+
+        ret = class_register(&pl_parallel_class);
+        if(ret) {
+                pr_err("%s: Register class failed.\n", THIS_MODULE->name);
+                return ret;
+        }
+
+        ret = alloc_chrdev_region(&pl_parallel_devt, 0, MAX_DEVICES, 
+                                  DEVICE_NAME);
+        if(ret) {
+                pr_err("%s: Alloc cdev region failed.\n", THIS_MODULE->name);
+                goto cdev_region_alloc_fail;
+        }
+
+        pl_parallel_debugfs = debugfs_create_dir(THIS_MODULE->name, NULL);
+
+        ret = platform_driver_probe(&pl_parallel_driver, pl_parallel_probe);
+        if(ret)
+                goto driver_probe_fail;
+
+        return 0;
+
+driver_probe_fail:
+        debugfs_remove_recursive(pl_parallel_debugfs);
+        unregister_chrdev_region(pl_parallel_devt, MAX_DEVICES);
+cdev_region_alloc_fail:
+        class_unregister(&pl_parallel_class);
+        return ret;
 }
 
 static void __exit pl_parallel_exit(void)
 {
         pr_info("%s: Exiting module...\n", THIS_MODULE->name);
         platform_driver_unregister(&pl_parallel_driver);
+        debugfs_remove_recursive(pl_parallel_debugfs);
+        unregister_chrdev_region(pl_parallel_devt, MAX_DEVICES);
+        class_unregister(&pl_parallel_class);
 }
 
 module_init(pl_parallel_init);